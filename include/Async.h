@@ -0,0 +1,65 @@
+#ifndef ASYNC_H
+#define ASYNC_H
+
+/*
+ * Asynchronous variants of the conditioning operations. They return immediately, and the
+ *   operations run on a library-owned pool of background threads, so the caller can continue
+ *   working on other buffers in the meantime.
+ *
+ * The buffer (and the meta data of inverse operations) must stay valid and untouched until
+ *   the operation completes. Output meta data is only valid after completion as well.
+ *
+ * Completion is signaled in two ways: the returned future becomes ready with the return
+ *   value of the operation, and the optional callback is invoked with that value and
+ *   `user_data`. The callback runs on a pool thread before the future becomes ready, so it
+ *   can chain further work, e.g., submitting I/O, without anybody waiting on the future.
+ *   It should not block for a long time, as it occupies a pool thread.
+ *
+ * If the operation throws (e.g., std::bad_alloc), the callback is not invoked. If either the
+ *   operation or the callback throws, the exception is stored in the future and rethrown by
+ *   its get(), instead of terminating the pool thread.
+ */
+
+#include <future>
+
+#include "MURaMKit.h"
+
+namespace mkit {
+
+using async_callback = void (*)(int rtn, void* user_data);
+
+// Set the maximum number of operations that run concurrently (default 2), and the number of
+//   OpenMP threads that each operation uses (default 0, meaning the number of available
+//   OpenMP threads divided by the maximum number of concurrent operations). Operations
+//   that are already running finish with their old settings. It can also be called from a
+//   callback. Returns 0 upon success.
+auto set_async_limits(size_t max_tasks, size_t threads_per_task) -> int;
+
+template <typename T>
+auto smart_log_async(T* buf,
+                     size_t buf_len,
+                     void** meta,
+                     async_callback callback = nullptr,
+                     void* user_data = nullptr) -> std::future<int>;
+template <typename T>
+auto smart_exp_async(T* buf,
+                     size_t buf_len,
+                     const void* meta,
+                     async_callback callback = nullptr,
+                     void* user_data = nullptr) -> std::future<int>;
+template <typename T>
+auto slice_norm_async(T* buf,
+                      dims_type dims,
+                      void** meta,
+                      async_callback callback = nullptr,
+                      void* user_data = nullptr) -> std::future<int>;
+template <typename T>
+auto inv_slice_norm_async(T* buf,
+                          dims_type dims,
+                          const void* meta,
+                          async_callback callback = nullptr,
+                          void* user_data = nullptr) -> std::future<int>;
+
+};  // namespace mkit
+
+#endif
@@ -14,8 +14,21 @@
  * Bitmask does not automatically adjust its size. The size of a Bitmask is initialized
  *   at construction time, and is only changed by users calling the resize() method.
  *   The current size of a Bitmask can be queried by the size() method.
+ *
+ * Bulk operations (bitwise_and(), count(), find_next_set(), etc.) work on whole 64-bit words
+ *   and run in parallel on large masks. They only consider the first size() bits, so bits
+ *   beyond size() in the last word never affect their results. Binary operations are meant
+ *   for masks of the same size; when `other` is smaller, the bits that it does not hold
+ *   count as zeros, and when it is larger, its extra bits are ignored.
+ *
+ * Bits beyond size() in the last word are left unspecified, e.g., bitwise_not() flips them.
+ *   They are visible in view_buffer(), so consumers of the raw words should mask them.
+ *
+ * Positions of all set bits can be visited in increasing order using a range-based for loop:
+ *   for (auto idx : mask.set_bits()) { ... }
  */
 
+#include <bit>
 #include <cstddef>
 #include <cstdint>
 #include <vector>
@@ -54,7 +67,56 @@ class Bitmask {
   auto view_buffer() const -> const std::vector<uint64_t>&;
   void use_bitstream(const void* p);
 
+  // Bulk operations
+  //
+  void bitwise_and(const Bitmask& other);
+  void bitwise_or(const Bitmask& other);
+  void bitwise_xor(const Bitmask& other);
+  void bitwise_not();
+  auto count() const -> size_t;                          // Num. of set bits.
+  auto count(size_t start, size_t end) const -> size_t;  // Num. of set bits in [start, end).
+  auto find_next_set(size_t idx) const -> size_t;    // Returns size() if there is none.
+  auto find_next_unset(size_t idx) const -> size_t;  // Returns size() if there is none.
+  auto operator==(const Bitmask& other) const -> bool;
+
+  // Iteration over positions of set bits
+  //
+  class SetBitIterator {
+   public:
+    SetBitIterator(const Bitmask* mask, size_t word_idx);
+    auto operator*() const -> size_t { return m_word_idx * 64 + std::countr_zero(m_word); }
+    auto operator++() -> SetBitIterator&;
+    auto operator==(const SetBitIterator& other) const -> bool
+    {
+      return m_word_idx == other.m_word_idx && m_word == other.m_word;
+    }
+
+   private:
+    void skip_empty_words();
+
+    const Bitmask* m_mask = nullptr;
+    size_t m_word_idx = 0;
+    uint64_t m_word = 0;  // Remaining set bits of the current word.
+  };
+
+  class SetBitRange {
+   public:
+    explicit SetBitRange(const Bitmask* mask) : m_mask(mask) {}
+    auto begin() const -> SetBitIterator { return SetBitIterator(m_mask, 0); }
+    auto end() const -> SetBitIterator { return SetBitIterator(m_mask, m_mask->m_buf.size()); }
+
+   private:
+    const Bitmask* m_mask = nullptr;
+  };
+
+  auto set_bits() const -> SetBitRange;
+
  private:
+  // Returns the word at `widx` with bits beyond the size of this mask cleared.
+  auto masked_word(size_t widx) const -> uint64_t;
+  // Same as masked_word(), but returns 0 beyond the last word.
+  auto word_or_zero(size_t widx) const -> uint64_t;
+
   std::vector<uint64_t> m_buf;
   size_t m_num_bits = 0;
 };
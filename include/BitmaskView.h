@@ -0,0 +1,39 @@
+#ifndef BITMASKVIEW_H
+#define BITMASKVIEW_H
+
+/*
+ * BitmaskView provides the read functions of Bitmask over memory that it does not own,
+ *   e.g., a mask stored in a meta data buffer, so that decoding does not need to allocate
+ *   and copy the mask. The memory must stay valid for the lifetime of the view.
+ *
+ * The memory is interpreted as consecutive 64-bit words in the same layout produced by
+ *   Bitmask::view_buffer(). It does not need to be aligned; every word is read in a way that
+ *   is safe for any address.
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mkit {
+
+class BitmaskView {
+ public:
+  // Constructor
+  //
+  BitmaskView(const void* p = nullptr, size_t nbits = 0);
+
+  auto size() const -> size_t;  // Num. of useful bits in this mask.
+
+  // Functions for read, with the same semantics as those of Bitmask
+  //
+  auto read_long(size_t idx) const -> uint64_t;
+  auto read_bit(size_t idx) const -> bool;
+
+ private:
+  const uint8_t* m_ptr = nullptr;
+  size_t m_num_bits = 0;
+};
+
+};  // namespace mkit
+
+#endif
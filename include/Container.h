@@ -0,0 +1,113 @@
+#ifndef CONTAINER_H
+#define CONTAINER_H
+
+/*
+ * A .mkit container keeps multiple conditioned fields, together with their meta data, in a
+ *   single file. The layout of a container is:
+ *
+ *   - A fixed 64-byte header: magic (8 bytes), version (uint32_t), number of fields (uint32_t),
+ *     byte offset of the field table (uint64_t), byte length of the field table (uint64_t),
+ *     and zero-filled reserved bytes.
+ *   - The fields: each payload starts at a 4 KiB aligned offset and is directly followed by
+ *     the meta data of that field.
+ *   - The field table: for each field, its name, precision, dimensions, the chain of
+ *     operations that were applied (in order), and the offsets and lengths of its payload
+ *     and meta data.
+ *
+ * ContainerWriter streams fields to disk one at a time, so only one field needs to be in
+ *   memory. ContainerReader memory-maps a container and locates any field through the field
+ *   table, so reading one field only touches the pages of that field.
+ *
+ * All methods that can fail return 0 upon success, and non-zero otherwise.
+ */
+
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "MURaMKit.h"
+
+namespace mkit {
+
+// Identifiers of operations that can be recorded in the operation chain of a field.
+enum class Op : uint8_t {
+  smart_log = 1,
+  slice_norm = 2,
+  bitmask_zero = 3,
+  tile_norm = 4,
+  smart_asinh = 5,
+  preview = 6,  // The payload is a preview pyramid of a field of the recorded dimensions.
+};
+
+struct FieldInfo {
+  std::string name;
+  bool is_float = false;
+  dims_type dims = {0, 0, 0};
+  std::vector<Op> ops;  // In the order that they were applied.
+  const void* payload = nullptr;
+  size_t payload_len = 0;  // In number of bytes
+  const void* meta = nullptr;
+  size_t meta_len = 0;  // In number of bytes
+};
+
+class ContainerWriter {
+ public:
+  ContainerWriter() = default;
+  ContainerWriter(const ContainerWriter&) = delete;
+  ContainerWriter& operator=(const ContainerWriter&) = delete;
+  ~ContainerWriter();  // Finishes the container if not done yet.
+
+  auto open(const std::string& filename) -> int;
+
+  // `meta` may be nullptr when `meta_len` is zero. Field names must be unique.
+  auto add_field(const std::string& name,
+                 bool is_float,
+                 dims_type dims,
+                 const std::vector<Op>& ops,
+                 const void* payload,
+                 size_t payload_len,
+                 const void* meta,
+                 size_t meta_len) -> int;
+
+  // Write the field table and the header, and close the file.
+  auto finish() -> int;
+
+ private:
+  struct Entry {
+    FieldInfo info;
+    uint64_t payload_offset = 0;
+    uint64_t meta_offset = 0;
+  };
+
+  std::FILE* m_file = nullptr;
+  uint64_t m_pos = 0;  // Current write position
+  std::vector<Entry> m_entries;
+};
+
+class ContainerReader {
+ public:
+  ContainerReader() = default;
+  ContainerReader(const ContainerReader&) = delete;
+  ContainerReader& operator=(const ContainerReader&) = delete;
+  ~ContainerReader();
+
+  auto open(const std::string& filename) -> int;
+  void close();
+
+  auto num_fields() const -> size_t;
+  auto field(size_t idx) const -> const FieldInfo&;
+
+  // Returns nullptr if no field has the specified name.
+  auto find(const std::string& name) const -> const FieldInfo*;
+
+ private:
+  void* m_addr = nullptr;
+  size_t m_len = 0;
+  std::vector<FieldInfo> m_fields;
+  std::unordered_map<std::string, size_t> m_lookup;
+};
+
+};  // namespace mkit
+
+#endif
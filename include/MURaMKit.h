@@ -4,6 +4,7 @@
 #include <array>
 #include <cstddef>  // size_t
 #include <cstdint>  // fixed width integers
+#include <type_traits>
 #include <vector>   // fixed width integers
 
 namespace mkit {
@@ -11,6 +12,8 @@ namespace mkit {
 using std::size_t;
 using dims_type = std::array<size_t, 3>;
 
+class Sketch;  // Defined in Sketch.h
+
 template <typename T>
 auto smart_log(T* buf, size_t buf_len, void** meta) -> int;
 template <typename T>
@@ -21,19 +24,379 @@ template <typename T>
 auto slice_norm(T* buf, dims_type dims, void** meta) -> int;
 template <typename T>
 auto inv_slice_norm(T* buf, dims_type dims, const void* meta) -> int;
+
+//
+// Out-of-place variants that read `input` of type T1 and write `output` of type T2 in the
+// same pass, e.g., reading double and writing float. `input` and `output` may be the same
+// buffer only when T1 and T2 are the same type.
+//
+template <typename T1, typename T2>
+auto smart_log(const T1* input, T2* output, size_t buf_len, void** meta) -> int;
+template <typename T1, typename T2>
+auto smart_exp(const T1* input, T2* output, size_t buf_len, const void* meta) -> int;
+template <typename T1, typename T2>
+auto slice_norm(const T1* input, T2* output, dims_type dims, void** meta) -> int;
+template <typename T1, typename T2>
+auto inv_slice_norm(const T1* input, T2* output, dims_type dims, const void* meta) -> int;
 auto retrieve_slice_norm_meta_len(const void* meta) -> size_t;  // In number of bytes
 
+//
+// Slice statistics of a time series change little between outputs. slice_norm_stale()
+// applies the statistics in `stats`, the meta data of an earlier slice_norm() (or of an
+// earlier slice_norm_stale() as `next_stats`) on a volume of the same dimensions, in a single
+// pass instead of two reduction passes and one more pass to apply them. `meta` receives the
+// statistics that were applied, for inv_slice_norm(). Optionally, the same pass also
+// refreshes the statistics from this volume into `next_stats`, and reports `drift`, the
+// largest change of a slice mean (in units of the old RMS) or relative change of a slice RMS,
+// so that callers can decide when to run a full slice_norm() again.
+// `next_stats` and `drift` may be nullptr.
+//
+template <typename T>
+auto slice_norm_stale(T* buf,
+                      dims_type dims,
+                      const void* stats,
+                      void** meta,
+                      void** next_stats,
+                      double* drift) -> int;
+template <typename T1, typename T2>
+auto slice_norm_stale(const T1* input,
+                      T2* output,
+                      dims_type dims,
+                      const void* stats,
+                      void** meta,
+                      void** next_stats,
+                      double* drift) -> int;
+
+//
+// A preview pyramid keeps mean-reduced copies of the original data at 2x, 4x, and 8x coarser
+// resolutions (levels 1, 2, and 3) in single precision, so that quick-look tools can open a
+// small level without touching the full field. slice_norm() builds it in its first pass
+// over the data when `preview` is not nullptr; preview_pyramid() builds it alone.
+// The caller needs to free() the preview buffer.
+//
+constexpr int preview_levels = 3;
+template <typename T>
+auto slice_norm(T* buf, dims_type dims, void** meta, void** preview) -> int;
+template <typename T1, typename T2>
+auto slice_norm(const T1* input, T2* output, dims_type dims, void** meta, void** preview)
+    -> int;
+template <typename T>
+auto preview_pyramid(const T* input, dims_type dims, void** preview) -> int;
+auto retrieve_preview_len(const void* preview) -> size_t;  // In number of bytes
+// Returns the values of a level and fills its dimensions, or nullptr if no such level.
+auto retrieve_preview_level(const void* preview, int level, dims_type* dims) -> const float*;
+
+//
+// A block index records the min, max, mean, and number of zeros of the original values in
+// every block of a field, so that queries can locate the blocks that might hold values of
+// interest without decoding the whole field. Indices are self-describing, and
+// smart_log() and slice_norm() build them within their passes over the data upon request:
+//  - smart_log() with LOG_BLOCK_INDEX uses blocks of 4096 consecutive values;
+//  - slice_norm() with NORM_BLOCK_INDEX uses blocks of 16^3 values.
+// The index is kept at the end of their meta data; block_index() builds one alone.
+//
+struct BlockStats {
+  double min = 0.0;
+  double max = 0.0;
+  double mean = 0.0;
+  uint64_t num_zero = 0;
+
+  // Used when building an index, during which `mean` holds the sum of values.
+  void add(double v)
+  {
+    min = (v < min) ? v : min;
+    max = (v > max) ? v : max;
+    mean += v;
+    num_zero += (v == 0.0);
+  }
+};
+constexpr uint8_t LOG_BLOCK_INDEX = 0x01;   // Option of smart_log()
+constexpr uint8_t NORM_BLOCK_INDEX = 0x01;  // Option of slice_norm()
+constexpr size_t log_block_len = 4096;
+constexpr size_t norm_block_dim = 16;
+
+// smart_log() with LOG_BASE2 replaces the natural log by a transform made of bit operations:
+// |v| = 2^e * (1 + f) becomes e + f, a monotone, piecewise-linear approximation of log2|v|
+// that runs at close to memory speed. Zeros map to the lowest value, so only signs are kept
+// in the meta data. The transformed values need to keep all their bits for smart_exp() to
+// restore the exact bit patterns of the input, so the mode requires float input and double
+// output; smart_log() returns 1 for other combinations.
+constexpr uint8_t LOG_BASE2 = 0x02;  // Option of smart_log()
+template <typename T1, typename T2>
+auto smart_log(const T1* input, T2* output, size_t buf_len, void** meta, uint8_t options)
+    -> int;
+template <typename T1, typename T2>
+auto slice_norm(const T1* input,
+                T2* output,
+                dims_type dims,
+                void** meta,
+                void** preview,
+                uint8_t options) -> int;
+template <typename T>
+auto block_index(const T* buf, dims_type dims, dims_type block, void** index) -> int;
+auto retrieve_block_index_len(const void* index) -> size_t;  // In number of bytes
+auto retrieve_num_blocks(const void* index) -> size_t;
+// Blocks are numbered with x varying the fastest. `begin` and `end` may be nullptr.
+auto retrieve_block_stats(const void* index, size_t idx, dims_type* begin, dims_type* end)
+    -> BlockStats;
+// Blocks whose value range overlaps [lo, hi].
+auto query_blocks(const void* index, double lo, double hi) -> std::vector<size_t>;
+// Locate the index in meta data, or nullptr if there is none.
+auto locate_log_block_index(const void* meta) -> const void*;
+auto locate_slice_norm_block_index(const void* meta, dims_type dims) -> const void*;
+
+//
+// Variants that also fill sketches (see Sketch.h) of input and output values in the same
+// pass, so that the value distributions, e.g., for choosing compression tolerances, come at
+// no extra cost. Either sketch may be nullptr. Values are added on top of what the sketches
+// already hold, so one sketch can accumulate many fields or snapshots.
+//
+template <typename T1, typename T2>
+auto smart_log(const T1* input,
+               T2* output,
+               size_t buf_len,
+               void** meta,
+               uint8_t options,
+               Sketch* in_sketch,
+               Sketch* out_sketch) -> int;
+template <typename T1, typename T2>
+auto slice_norm(const T1* input,
+                T2* output,
+                dims_type dims,
+                void** meta,
+                void** preview,
+                uint8_t options,
+                Sketch* in_sketch,
+                Sketch* out_sketch) -> int;
+
+//
+// Tile-based normalization subtracts the mean and divides by the RMS of each tile, e.g.,
+// 64x64x1 for 2D fields or 32x32x32 for volumes with strong horizontal inhomogeneity.
+// Tiles at the upper boundaries may be smaller, and a tile bigger than the volume is
+// clamped to the volume. Each tile is normalized while it is in cache, so the whole
+// operation takes one pass over memory. The means and RMS are stored in single precision.
+//
+template <typename T>
+auto tile_norm(T* buf, dims_type dims, dims_type tile, void** meta) -> int;
+template <typename T>
+auto inv_tile_norm(T* buf, dims_type dims, const void* meta) -> int;
+template <typename T1, typename T2>
+auto tile_norm(const T1* input, T2* output, dims_type dims, dims_type tile, void** meta) -> int;
+template <typename T1, typename T2>
+auto inv_tile_norm(const T1* input, T2* output, dims_type dims, const void* meta) -> int;
+auto retrieve_tile_norm_meta_len(const void* meta) -> size_t;  // In number of bytes
+
+//
+// smart_asinh() applies asinh(x / s), which behaves like a log for large magnitudes and
+// stays linear around zero, so it handles negative values and zeros natively and needs no
+// masks. The scale s is a power of two chosen from the binary exponents of the data in a
+// single reduction pass, at two standard deviations below their mean. The meta data only
+// keeps the number of values and s. smart_sinh() performs the inverse.
+//
+template <typename T>
+auto smart_asinh(T* buf, size_t buf_len, void** meta) -> int;
+template <typename T>
+auto smart_sinh(T* buf, size_t buf_len, const void* meta) -> int;
+template <typename T1, typename T2>
+auto smart_asinh(const T1* input, T2* output, size_t buf_len, void** meta) -> int;
+template <typename T1, typename T2>
+auto smart_sinh(const T1* input, T2* output, size_t buf_len, const void* meta) -> int;
+auto retrieve_asinh_meta_len(const void* meta) -> size_t;  // In number of bytes
+
+//
+// Permute the axes of a volume into any of the six orders, which are named by the axes of
+// the input that become the fastest, middle, and slowest axes of the output, e.g.,
+// PERMUTE_ZXY turns a volume with height as the fastest axis into one with height as the
+// slowest axis. The kernel works on cache-sized tiles, and can apply a conditioning stage
+// on each tile while it is in cache, instead of running it as another pass:
+//    - PERMUTE_STAGE_LOG applies smart_log() on the permuted values;
+//    - PERMUTE_STAGE_NORM applies slice_norm() on the permuted volume.
+// The meta data records the original dimensions, the order, and the stage, followed by
+// the same meta data that the stage would produce on the permuted volume. inv_permute()
+// undoes the stage and restores the original layout in one pass. `input` and `output`
+// must be different buffers unless the order is PERMUTE_XYZ.
+//
+constexpr uint8_t PERMUTE_XYZ = 0;
+constexpr uint8_t PERMUTE_XZY = 1;
+constexpr uint8_t PERMUTE_YXZ = 2;
+constexpr uint8_t PERMUTE_YZX = 3;
+constexpr uint8_t PERMUTE_ZXY = 4;
+constexpr uint8_t PERMUTE_ZYX = 5;
+constexpr uint8_t PERMUTE_STAGE_NONE = 0;
+constexpr uint8_t PERMUTE_STAGE_LOG = 1;
+constexpr uint8_t PERMUTE_STAGE_NORM = 2;
+template <typename T1, typename T2>
+auto permute(const T1* input,
+             T2* output,
+             dims_type dims,
+             uint8_t order,
+             uint8_t stage,
+             void** meta) -> int;
+template <typename T1, typename T2>
+auto inv_permute(const T1* input, T2* output, const void* meta) -> int;
+auto retrieve_permute_meta_len(const void* meta) -> size_t;  // In number of bytes
+auto retrieve_permute_dims(const void* meta) -> dims_type;   // Dimensions before permuting
+auto permuted_dims(dims_type dims, uint8_t order) -> dims_type;
+
 template <typename T>
 auto bitmask_zero(const T* input, size_t len, void** output) -> int;
 auto inv_bitmask_zero(const void* input, void** output) -> int;
 auto retrieve_bitmask_zero_buf_len(const void* input) -> size_t;  // In number of bytes
 
+// Options of bitmask_zero() that are recorded in its output; they can be combined with
+// bitwise OR. Bit 0 of that byte is taken by the precision, so the options start at bit 1.
+constexpr uint8_t BZ_SHUFFLE = 0x02;            // Byte-shuffle the nonzero values.
+constexpr uint8_t BZ_SHUFFLE_BIT_PLANE = 0x04;  // Shuffle in bit planes (implies BZ_SHUFFLE).
+constexpr uint8_t BZ_SHUFFLE_XOR_DELTA = 0x08;  // XOR delta before shuffle (implies BZ_SHUFFLE).
+constexpr uint8_t BZ_SHUFFLE_ALL = BZ_SHUFFLE | BZ_SHUFFLE_BIT_PLANE | BZ_SHUFFLE_XOR_DELTA;
+constexpr uint8_t BZ_GORILLA = 0x10;  // XOR-code the nonzero values (excludes BZ_SHUFFLE_ALL).
+constexpr uint8_t BZ_ADAPTIVE = 0x20;  // Code the mask per block of 4096 values (see below).
+constexpr uint8_t BZ_VALUE_LIST = 0x40;  // Fill values are recorded; set by bitmask_value().
+constexpr uint8_t BZ_ALL_OPTIONS = BZ_SHUFFLE_ALL | BZ_GORILLA | BZ_ADAPTIVE | BZ_VALUE_LIST;
+template <typename T>
+auto bitmask_zero(const T* input, size_t len, void** output, uint8_t options) -> int;
+
+//
+// bitmask_value() generalizes bitmask_zero() to fields with large constant regions at other
+// values, e.g., floor densities, clipped temperatures, or boundary fill values. Values that
+// are bitwise equal to one of up to four fill values are marked in the mask, and only the
+// other values are kept. The fill values are given in `fills`, or when `fills` is nullptr,
+// up to `num_fills` of them are found as the values repeated the most in runs of equal
+// neighbors. The output records the fill values, takes the same options as bitmask_zero(),
+// and is decoded by inv_bitmask_zero() and measured by retrieve_bitmask_zero_buf_len().
+//
+constexpr size_t bitmask_value_max_fills = 4;
+template <typename T>
+auto bitmask_value(const T* input,
+                   size_t len,
+                   const std::type_identity_t<T>* fills,  // So that nullptr can be passed
+                   size_t num_fills,
+                   void** output,
+                   uint8_t options) -> int;
+
+//
+// Byte shuffle groups bytes (or bits) of the same significance of all values together,
+// which makes the data friendlier to general-purpose lossless compressors.
+//
+constexpr uint8_t SHUFFLE_BIT_PLANE = 1;  // Group bits instead of bytes.
+constexpr uint8_t SHUFFLE_XOR_DELTA = 2;  // XOR each value with its predecessor first.
+template <typename T>
+auto byte_shuffle(const T* input, size_t len, uint8_t flags, void** output) -> int;
+auto inv_byte_shuffle(const void* input, void** output) -> int;
+auto retrieve_byte_shuffle_buf_len(const void* input) -> size_t;  // In number of bytes
+
+//
+// Temporal delta encodes a field as its residual against a reference snapshot of the same
+// field. References are kept in a library-managed cache keyed by field names: the first
+// snapshot of a field, and every `keyframe_interval`-th snapshot after it, is a keyframe
+// that is left unchanged and becomes the new reference. On the decoding side, keyframes
+// need to be passed to inv_temporal_delta() before the snapshots that refer to them; the
+// decoded keyframe, rather than the original one, then serves as the reference.
+//
+// Prediction is closed-loop: the encoder only uses a keyframe as a reference once the
+// caller passes its reconstruction, i.e., the values that the decoder will see, to
+// set_temporal_reference() together with the keyframe's meta data. Lossless pipelines pass
+// the keyframe itself. Until then, every snapshot of the field is encoded as a keyframe.
+//
+constexpr uint8_t DELTA_DIFF = 0;   // residual = value - reference
+constexpr uint8_t DELTA_RATIO = 1;  // residual = value / reference (unchanged if reference is 0)
+template <typename T>
+auto temporal_delta(T* buf,
+                    size_t buf_len,
+                    const char* field,
+                    uint8_t mode,
+                    uint32_t keyframe_interval,
+                    void** meta) -> int;
+template <typename T>
+auto set_temporal_reference(const T* buf, size_t buf_len, const char* field, const void* meta)
+    -> int;
+template <typename T>
+auto inv_temporal_delta(T* buf, size_t buf_len, const char* field, const void* meta) -> int;
+constexpr size_t temporal_meta_len = 14;                      // In number of bytes
+auto retrieve_temporal_meta_len(const void* meta) -> size_t;  // In number of bytes
+void clear_temporal_cache(const char* field);  // Clear all fields if `field` is nullptr
+
+//
+// Gather statistics of a field in a single pass, and predict the output sizes of
+// operations, so that the operations to apply can be chosen before running them.
+//
+struct Analysis {
+  double min = 0.0;  // Over finite values
+  double max = 0.0;  // Over finite values
+  size_t num_neg = 0;
+  size_t num_zero = 0;       // Absolute zeros
+  size_t num_near_zero = 0;  // Values that bitmask_zero() treats as zero
+  size_t num_finite = 0;
+  size_t num_nan = 0;
+  size_t num_inf = 0;
+
+  // Predicted output sizes, in number of bytes
+  size_t log_meta_len = 0;
+  size_t bitmask_zero_buf_len = 0;
+  size_t byte_shuffle_buf_len = 0;
+  size_t temporal_meta_len = 0;
+};
+template <typename T>
+auto analyze(const T* buf, size_t len, Analysis* result) -> int;
+
+//
+// Compare a field `a` with its reconstruction `b` in a single pass. Pairs where either value
+// is not finite are left out of the metrics, and only counted when they do not match, e.g.,
+// a NaN against a number, or infinities of different signs.
+//
+struct Metrics {
+  double max_abs_err = 0.0;  // max |b - a|
+  size_t max_abs_idx = 0;    // Index of the first value with max_abs_err
+  double max_rel_err = 0.0;  // max |b - a| / |a|, over nonzero a
+  size_t max_rel_idx = 0;    // Index of the first value with max_rel_err
+  double rmse = 0.0;
+  double psnr = 0.0;  // 20 * log10((max(a) - min(a)) / rmse); infinite if rmse is 0
+  double bias = 0.0;  // mean(b - a)
+  size_t num_over_threshold = 0;  // Number of values where |b - a| > threshold
+  size_t num_compared = 0;        // Number of pairs where both values are finite
+  size_t num_nonfinite_mismatch = 0;
+};
+template <typename T>
+auto compare(const T* a, const T* b, size_t len, double threshold, Metrics* result) -> int;
+
 //
 // Helper functions that are not supposed to be used by end users.
 //
 auto calc_log_meta_len(size_t buf_len, uint8_t treatment) -> size_t;  // In number of bytes
+constexpr uint8_t log_state_pos = 0;   // States of values that smart_log() records in base 3
+constexpr uint8_t log_state_neg = 1;   // when there are both negative values and zeros.
+constexpr uint8_t log_state_zero = 2;
 auto pack_8_booleans(std::array<bool, 8>) -> uint8_t;
 auto unpack_8_booleans(uint8_t) -> std::array<bool, 8>;
+auto calc_bitmask_zero_buf_len(size_t num_vals, size_t num_nonzero, size_t width, uint8_t options)
+    -> size_t;  // In number of bytes; an upper bound with BZ_GORILLA or BZ_ADAPTIVE
+auto calc_bitmask_value_buf_len(size_t num_vals,
+                                size_t num_others,
+                                size_t width,
+                                size_t num_fills,
+                                uint8_t options) -> size_t;  // Same as above
+auto calc_block_index_len(dims_type dims, dims_type block) -> size_t;  // In number of bytes
+void init_block_stats(BlockStats* stats, size_t num_blocks);
+void write_block_index(dims_type dims, dims_type block, const BlockStats* sums, void* dst);
+auto preview_level_dims(dims_type dims, int level) -> dims_type;
+auto calc_preview_len(dims_type dims) -> size_t;  // In number of bytes
+auto finish_preview(dims_type dims, const double* level1_sums) -> void*;
+auto calc_shuffle_len(size_t num_vals, size_t width, uint8_t flags) -> size_t;  // In bytes
+void shuffle_bytes(const void* input, size_t num_vals, size_t width, uint8_t flags, void* output);
+void unshuffle_bytes(const void* input, size_t num_vals, size_t width, uint8_t flags, void* output);
+auto gorilla_encode(const void* input, size_t num_vals, size_t width) -> std::vector<uint8_t>;
+void gorilla_decode(const void* input, size_t num_vals, size_t width, void* output);
+auto retrieve_gorilla_len(const void* input, size_t num_vals) -> size_t;  // In bytes
+auto calc_gorilla_max_len(size_t num_vals, size_t width) -> size_t;        // In bytes
+
+// BZ_ADAPTIVE codes every block of 4096 bits of a mask in the smallest of these forms: no
+//    payload when all bits are set or unset, the bitmask words, or a list of the positions of
+//    the fewer of the set or unset bits, delta-encoded. A directory of block offsets lets
+//    blocks be coded and decoded in parallel.
+auto adaptive_mask_encode(const uint64_t* words, size_t num_bits) -> std::vector<uint8_t>;
+void adaptive_mask_decode(const void* input, size_t num_bits, uint64_t* words);
+auto retrieve_adaptive_mask_len(const void* input, size_t num_bits) -> size_t;  // In bytes
+auto calc_adaptive_mask_max_len(size_t num_bits) -> size_t;                      // In bytes
 
 };  // namespace mkit
 
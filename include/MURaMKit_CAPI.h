@@ -33,6 +33,24 @@ int mkit_slice_norm(
                       *    !! Note that the caller will need to free() this chunk of    *
                       *       memory to prevent any memory leak !!                      */
 
+/*
+ * Applies the statistics of an earlier mkit_slice_norm() on a volume of the same dimensions
+ * in a single pass, e.g., on the next output of a time series. Optionally refreshes the
+ * statistics from this volume in the same pass, and reports how far they have drifted.
+ */
+int mkit_slice_norm_stale(
+    void* buf,          /* Input and Output: a buffer of double or float values */
+    int is_float,       /* Input: data type: 1 == float, 0 == double */
+    size_t dim_fast,    /* Input: number of values in the fastest varying dimension */
+    size_t dim_mid,     /* Input: number of values in the middle dimension */
+    size_t dim_slow,    /* Input: number of values in the slowest varying dimension */
+    const void* stats,  /* Input: meta data of an earlier mkit_slice_norm(), or next_stats  *
+                         *    of an earlier mkit_slice_norm_stale()                        */
+    void** meta,        /* Output: the applied statistics, for mkit_inv_slice_norm() */
+    void** next_stats,  /* Output: statistics of this volume, or NULL to skip */
+    double* drift);     /* Output: largest change of a slice mean (in units of the old RMS) *
+                         *    or relative change of a slice RMS, or NULL to skip           */
+
 int mkit_inv_slice_norm(
     void* buf,         /* Input and Output: a buffer of double or float values */
     int is_float,      /* Input: data type: 1 == float, 0 == double */
@@ -44,6 +62,257 @@ int mkit_inv_slice_norm(
 size_t mkit_slice_norm_meta_len(
     const void* meta); /* Input: the meta data generated by mkit_normalize() */
 
+/*
+ * A preview pyramid keeps mean-reduced copies of the original data at 2x, 4x, and 8x
+ * coarser resolutions (levels 1, 2, and 3) in single precision. mkit_slice_norm_preview()
+ * builds it in the same traversal as the normalization, and mkit_preview_pyramid() builds
+ * it alone. The caller needs to free() the preview buffer.
+ */
+int mkit_slice_norm_preview(
+    void* buf,       /* Input and Output: a buffer of double or float values */
+    int is_float,    /* Input: data type: 1 == float, 0 == double */
+    size_t dim_fast, /* Input: number of values in the fastest varying dimension */
+    size_t dim_mid,  /* Input: number of values in the middle dimension */
+    size_t dim_slow, /* Input: number of values in the slowest varying dimension */
+    void** meta,     /* Output: the meta data needed to perform a mkit_inv_slice_norm() */
+    void** preview); /* Output: the preview pyramid of the original data */
+
+int mkit_preview_pyramid(
+    const void* buf, /* Input: a buffer of double or float values */
+    int is_float,    /* Input: data type: 1 == float, 0 == double */
+    size_t dim_fast, /* Input: number of values in the fastest varying dimension */
+    size_t dim_mid,  /* Input: number of values in the middle dimension */
+    size_t dim_slow, /* Input: number of values in the slowest varying dimension */
+    void** preview); /* Output: the preview pyramid of buf */
+
+size_t mkit_preview_len(
+    const void* preview); /* Input: a preview pyramid */
+
+const float* mkit_preview_level(
+    const void* preview,  /* Input: a preview pyramid */
+    int level,            /* Input: 1, 2, or 3, for 2x, 4x, or 8x coarser resolutions */
+    size_t* dims);        /* Output: three dimensions of this level, or NULL if not needed. *
+                           * Returns the values of this level, or NULL upon invalid input.  */
+
+/*
+ * A block index records the min, max, mean, and number of zeros of the original values in
+ * every block of a field, so that queries can locate the blocks that might hold values of
+ * interest without decoding the whole field. mkit_smart_log_ex() (with blocks of 4096
+ * consecutive values) and mkit_slice_norm_ex() (with blocks of 16^3 values) build it within
+ * their passes over the data, and keep it at the end of their meta data.
+ */
+#define MKIT_LOG_BLOCK_INDEX 0x01  /* Option of mkit_smart_log_ex() */
+#define MKIT_LOG_BASE2 0x02        /* Option of mkit_smart_log_mixed_ex(): float in, double out */
+#define MKIT_NORM_BLOCK_INDEX 0x01 /* Option of mkit_slice_norm_ex() */
+
+struct mkit_block_stats {
+  double min;        /* minimum value of the block */
+  double max;        /* maximum value of the block */
+  double mean;       /* mean value of the block */
+  uint64_t num_zero; /* number of absolute zeros in the block */
+  size_t begin[3];   /* first coordinates of the block, from the fastest to the slowest */
+  size_t end[3];     /* one past the last coordinates of the block */
+};
+
+int mkit_smart_log_ex(
+    void* buf,       /* Input and Output: a buffer of double or float values */
+    int is_float,    /* Input: data type: 1 == float, 0 == double */
+    size_t buf_len,  /* Input: number of values in buf */
+    int options,     /* Input: a combination of MKIT_LOG_* options, or 0 */
+    void** meta);    /* Output: the meta data needed to perform a mkit_smart_exp() */
+
+int mkit_slice_norm_ex(
+    void* buf,       /* Input and Output: a buffer of double or float values */
+    int is_float,    /* Input: data type: 1 == float, 0 == double */
+    size_t dim_fast, /* Input: number of values in the fastest varying dimension */
+    size_t dim_mid,  /* Input: number of values in the middle dimension */
+    size_t dim_slow, /* Input: number of values in the slowest varying dimension */
+    int options,     /* Input: a combination of MKIT_NORM_* options, or 0 */
+    void** meta,     /* Output: the meta data needed to perform a mkit_inv_slice_norm() */
+    void** preview); /* Output: the preview pyramid of the original data, or NULL if not needed */
+
+int mkit_block_index(
+    const void* buf, /* Input: a buffer of double or float values */
+    int is_float,    /* Input: data type: 1 == float, 0 == double */
+    size_t dim_fast, /* Input: number of values in the fastest varying dimension */
+    size_t dim_mid,  /* Input: number of values in the middle dimension */
+    size_t dim_slow, /* Input: number of values in the slowest varying dimension */
+    const size_t* block, /* Input: three dimensions of a block, e.g., 32, 32, 32 */
+    void** index);   /* Output: a standalone block index; the caller needs to free() it */
+
+const void* mkit_log_block_index(
+    const void* meta);   /* Input: meta data generated by mkit_smart_log_ex().               *
+                          * Returns the block index in meta, or NULL if there is none.        */
+
+const void* mkit_slice_norm_block_index(
+    const void* meta,    /* Input: meta data generated by mkit_slice_norm_ex() */
+    size_t dim_fast,     /* Input: number of values in the fastest varying dimension */
+    size_t dim_mid,      /* Input: number of values in the middle dimension */
+    size_t dim_slow);    /* Input: number of values in the slowest varying dimension.        *
+                          * Returns the block index in meta, or NULL if there is none.        */
+
+size_t mkit_block_index_len(const void* index); /* Length of a block index in bytes */
+size_t mkit_num_blocks(const void* index);      /* Number of blocks in a block index */
+
+void mkit_get_block_stats(
+    const void* index,               /* Input: a block index */
+    size_t idx,                      /* Input: which block; x varies the fastest */
+    struct mkit_block_stats* stats); /* Output: statistics and extent of the block */
+
+size_t mkit_query_blocks(
+    const void* index,   /* Input: a block index */
+    double lo,           /* Input: lower end of the value range of interest */
+    double hi,           /* Input: upper end of the value range of interest */
+    size_t* blocks,      /* Output: blocks whose value range overlaps [lo, hi], or NULL */
+    size_t max_blocks);  /* Input: capacity of blocks.                                       *
+                          * Returns the number of overlapping blocks, which may be more than  *
+                          * max_blocks, in which case only the first max_blocks are written.  */
+
+/*
+ * Sketches are fixed-size, log-spaced histograms of values (8192 bins, each spanning a
+ * relative width of at most 1/16) that also answer quantile queries within 1/32 relative
+ * error. Sketches of different fields or ranks can be merged. mkit_smart_log_sketch() and
+ * mkit_slice_norm_sketch() fill sketches of input and output values in the same pass as the
+ * operation; either sketch handle may be NULL.
+ */
+void* mkit_sketch_create(void);          /* Returns an empty sketch */
+void mkit_sketch_destroy(void* sketch);
+
+int mkit_sketch_add(
+    void* sketch,        /* Input and Output: a handle returned by mkit_sketch_create() */
+    const void* buf,     /* Input: a buffer of double or float values */
+    int is_float,        /* Input: data type: 1 == float, 0 == double */
+    size_t len);         /* Input: number of values in buf */
+
+void mkit_sketch_merge(
+    void* sketch,        /* Input and Output: a sketch that receives all values of other */
+    const void* other);  /* Input: another sketch */
+
+uint64_t mkit_sketch_count(const void* sketch); /* Number of values in a sketch, except NaNs */
+
+double mkit_sketch_quantile(
+    const void* sketch,  /* Input: a sketch */
+    double q);           /* Input: in [0, 1], e.g., 0.5 for the median.                      *
+                          * Returns NaN if the sketch is empty.                              */
+
+size_t mkit_sketch_histogram(
+    const void* sketch,  /* Input: a sketch */
+    uint64_t* counts,    /* Output: count of each bin, or NULL */
+    double* lower,       /* Output: the smallest value of each bin, or NULL */
+    double* upper);      /* Output: the largest value of each bin, or NULL.                  *
+                          * Returns the number of bins, i.e., the capacity the three output  *
+                          * arrays need. Bins are in increasing order of their values.       */
+
+int mkit_smart_log_sketch(
+    void* buf,           /* Input and Output: a buffer of double or float values */
+    int is_float,        /* Input: data type: 1 == float, 0 == double */
+    size_t buf_len,      /* Input: number of values in buf */
+    void** meta,         /* Output: the meta data needed to perform a mkit_smart_exp() */
+    void* in_sketch,     /* Input and Output: receives the input values, or NULL */
+    void* out_sketch);   /* Input and Output: receives the output values, or NULL */
+
+int mkit_slice_norm_sketch(
+    void* buf,           /* Input and Output: a buffer of double or float values */
+    int is_float,        /* Input: data type: 1 == float, 0 == double */
+    size_t dim_fast,     /* Input: number of values in the fastest varying dimension */
+    size_t dim_mid,      /* Input: number of values in the middle dimension */
+    size_t dim_slow,     /* Input: number of values in the slowest varying dimension */
+    void** meta,         /* Output: the meta data needed to perform a mkit_inv_slice_norm() */
+    void* in_sketch,     /* Input and Output: receives the input values, or NULL */
+    void* out_sketch);   /* Input and Output: receives the output values, or NULL */
+
+/*
+ * Tile-based normalization subtracts the mean and divides by the RMS of each tile, which
+ * also works on 2D fields (dim_slow == 1) where mkit_slice_norm() does nothing.
+ */
+int mkit_tile_norm(
+    void* buf,          /* Input and Output: a buffer of double or float values */
+    int is_float,       /* Input: data type: 1 == float, 0 == double */
+    size_t dim_fast,    /* Input: number of values in the fastest varying dimension */
+    size_t dim_mid,     /* Input: number of values in the middle dimension */
+    size_t dim_slow,    /* Input: number of values in the slowest varying dimension */
+    size_t tile_fast,   /* Input: tile size in the fastest varying dimension, e.g., 64 */
+    size_t tile_mid,    /* Input: tile size in the middle dimension, e.g., 64 */
+    size_t tile_slow,   /* Input: tile size in the slowest varying dimension, e.g., 1 */
+    void** meta);       /* Output: the meta data needed to perform a mkit_inv_tile_norm()  *
+                         *    !! Note that the caller will need to free() this chunk of    *
+                         *       memory to prevent any memory leak !!                      */
+
+int mkit_inv_tile_norm(
+    void* buf,          /* Input and Output: a buffer of double or float values */
+    int is_float,       /* Input: data type: 1 == float, 0 == double */
+    size_t dim_fast,    /* Input: number of values in the fastest varying dimension */
+    size_t dim_mid,     /* Input: number of values in the middle dimension */
+    size_t dim_slow,    /* Input: number of values in the slowest varying dimension */
+    const void* meta);  /* Input: the meta data generated by mkit_tile_norm() */
+
+size_t mkit_tile_norm_meta_len(
+    const void* meta);  /* Input: the meta data generated by mkit_tile_norm() */
+
+/*
+ * A mask-free alternative to mkit_smart_log(): asinh(x / s) behaves like a log for large
+ * magnitudes and stays linear around zero, so negative values and zeros need no masks. The
+ * scale s is chosen from the data, and the meta data is only 16 bytes.
+ */
+int mkit_smart_asinh(
+    void* buf,          /* Input and Output: a buffer of double or float values */
+    int is_float,       /* Input: data type: 1 == float, 0 == double */
+    size_t buf_len,     /* Input: number of values in buf */
+    void** meta);       /* Output: the meta data needed to perform a mkit_smart_sinh()     *
+                         *    !! Note that the caller will need to free() this chunk of    *
+                         *       memory to prevent any memory leak !!                      */
+
+int mkit_smart_sinh(
+    void* buf,          /* Input and Output: a buffer of double or float values */
+    int is_float,       /* Input: data type: 1 == float, 0 == double */
+    size_t buf_len,     /* Input: number of values in buf */
+    const void* meta);  /* Input: meta data generated by mkit_smart_asinh() */
+
+size_t mkit_asinh_meta_len(
+    const void* meta);  /* Input: meta data generated by mkit_smart_asinh() */
+
+/*
+ * Permute the axes of a volume into one of six orders, with a cache-blocked kernel that can
+ * also apply a conditioning stage on each tile while it is in cache. Orders are named by the
+ * input axes that become the fastest, middle, and slowest output axes, e.g., MKIT_PERMUTE_ZXY
+ * moves the fastest input axis (X) to the middle and the slowest (Z) to the fastest.
+ * MKIT_PERMUTE_STAGE_LOG applies mkit_smart_log() and MKIT_PERMUTE_STAGE_NORM applies
+ * mkit_slice_norm() on the permuted volume. inbuf and outbuf must be different buffers.
+ */
+#define MKIT_PERMUTE_XYZ 0
+#define MKIT_PERMUTE_XZY 1
+#define MKIT_PERMUTE_YXZ 2
+#define MKIT_PERMUTE_YZX 3
+#define MKIT_PERMUTE_ZXY 4
+#define MKIT_PERMUTE_ZYX 5
+#define MKIT_PERMUTE_STAGE_NONE 0
+#define MKIT_PERMUTE_STAGE_LOG 1
+#define MKIT_PERMUTE_STAGE_NORM 2
+
+int mkit_permute(
+    const void* inbuf,  /* Input: a buffer of double or float values */
+    int in_is_float,    /* Input: data type of inbuf: 1 == float, 0 == double */
+    void* outbuf,       /* Output: the permuted (and conditioned) values */
+    int out_is_float,   /* Input: data type of outbuf: 1 == float, 0 == double */
+    size_t dim_fast,    /* Input: number of values in the fastest varying dimension of inbuf */
+    size_t dim_mid,     /* Input: number of values in the middle dimension of inbuf */
+    size_t dim_slow,    /* Input: number of values in the slowest varying dimension of inbuf */
+    int order,          /* Input: one of MKIT_PERMUTE_XYZ, ..., MKIT_PERMUTE_ZYX */
+    int stage,          /* Input: one of MKIT_PERMUTE_STAGE_* */
+    void** meta);       /* Output: the meta data needed to perform a mkit_inv_permute()    *
+                         *    !! Note that the caller will need to free() this chunk of    *
+                         *       memory to prevent any memory leak !!                      */
+
+int mkit_inv_permute(
+    const void* inbuf,  /* Input: values produced by mkit_permute() */
+    int in_is_float,    /* Input: data type of inbuf: 1 == float, 0 == double */
+    void* outbuf,       /* Output: the values in their original layout */
+    int out_is_float,   /* Input: data type of outbuf: 1 == float, 0 == double */
+    const void* meta);  /* Input: the meta data generated by mkit_permute() */
+
+size_t mkit_permute_meta_len(
+    const void* meta);  /* Input: the meta data generated by mkit_permute() */
+
 int mkit_bitmask_zero(
     const void* inbuf,  /* Input: a buffer of double or float values */
     int is_float,       /* Input: data type: 1 == float, 0 == double */
@@ -57,6 +326,401 @@ int mkit_inv_bitmask_zero(
 size_t mkit_bitmask_zero_buf_len(
     const void* input); /* Input: the compressed data produced by mkit_bitmask_zero() */
 
+/*
+ * Statistics of a field gathered in a single pass, together with predicted output sizes
+ * of operations, so that the operations to apply can be chosen before running them.
+ */
+struct mkit_analysis {
+  double min;           /* minimum of finite values */
+  double max;           /* maximum of finite values */
+  size_t num_neg;       /* number of negative values */
+  size_t num_zero;      /* number of absolute zeros */
+  size_t num_near_zero; /* number of values that mkit_bitmask_zero() treats as zero */
+  size_t num_finite;    /* number of finite values */
+  size_t num_nan;       /* number of NaNs */
+  size_t num_inf;       /* number of infinities */
+
+  size_t log_meta_len;         /* predicted output of mkit_log_meta_len() */
+  size_t bitmask_zero_buf_len; /* predicted output of mkit_bitmask_zero_buf_len() */
+  size_t byte_shuffle_buf_len; /* predicted output of mkit_byte_shuffle_buf_len() */
+  size_t temporal_meta_len;    /* predicted output of mkit_temporal_meta_len() */
+};
+
+int mkit_analyze(
+    const void* buf,                /* Input: a buffer of double or float values */
+    int is_float,                   /* Input: data type: 1 == float, 0 == double */
+    size_t len,                     /* Input: number of values in buf */
+    struct mkit_analysis* result);  /* Output: statistics of buf */
+
+/*
+ * Compare a field with its reconstruction in a single parallel pass. Pairs where either
+ * value is not finite are left out of the metrics, and only counted when they do not match.
+ */
+struct mkit_metrics {
+  double max_abs_err;            /* max |b - a| */
+  size_t max_abs_idx;            /* index of the first value with max_abs_err */
+  double max_rel_err;            /* max |b - a| / |a|, over nonzero a */
+  size_t max_rel_idx;            /* index of the first value with max_rel_err */
+  double rmse;                   /* root mean square error */
+  double psnr;                   /* 20 * log10((max(a) - min(a)) / rmse); inf if rmse is 0 */
+  double bias;                   /* mean of b - a */
+  size_t num_over_threshold;     /* number of values where |b - a| > threshold */
+  size_t num_compared;           /* number of pairs where both values are finite */
+  size_t num_nonfinite_mismatch; /* number of mismatching pairs of non-finite values */
+};
+
+int mkit_compare(
+    const void* a,                  /* Input: a buffer of original values */
+    const void* b,                  /* Input: a buffer of reconstructed values, of the same type */
+    int is_float,                   /* Input: data type: 1 == float, 0 == double */
+    size_t len,                     /* Input: number of values in each buffer */
+    double threshold,               /* Input: errors above it are counted */
+    struct mkit_metrics* result);   /* Output: error metrics of b against a */
+
+/*
+ * Options of mkit_bitmask_zero_ex(), which can be combined with bitwise OR.
+ */
+#define MKIT_BZ_SHUFFLE 0x02            /* Byte-shuffle the nonzero values */
+#define MKIT_BZ_SHUFFLE_BIT_PLANE 0x04  /* Shuffle in bit planes (implies MKIT_BZ_SHUFFLE) */
+#define MKIT_BZ_SHUFFLE_XOR_DELTA 0x08  /* XOR delta first (implies MKIT_BZ_SHUFFLE) */
+#define MKIT_BZ_GORILLA 0x10            /* XOR-code the nonzero values; excludes shuffling */
+#define MKIT_BZ_ADAPTIVE 0x20           /* Code the mask per block of 4096 values */
+
+int mkit_bitmask_zero_ex(
+    const void* inbuf,  /* Input: a buffer of double or float values */
+    int is_float,       /* Input: data type: 1 == float, 0 == double */
+    size_t len,         /* Input: number of values in buf */
+    int options,        /* Input: a combination of MKIT_BZ_* options, or 0 */
+    void** output);     /* Output: compressed form of input; decode with mkit_inv_bitmask_zero() */
+
+/*
+ * Generalizes mkit_bitmask_zero_ex() to fields with large constant regions at other values:
+ * values that are bitwise equal to one of the fill values are marked in the mask, and only
+ * the other values are kept.
+ */
+#define MKIT_BITMASK_VALUE_MAX_FILLS 4
+
+int mkit_bitmask_value(
+    const void* inbuf,  /* Input: a buffer of double or float values */
+    int is_float,       /* Input: data type: 1 == float, 0 == double */
+    size_t len,         /* Input: number of values in buf */
+    const void* fills,  /* Input: fill values of the same type as inbuf, or NULL to find the  *
+                         *    values repeated the most in runs of equal neighbors            */
+    size_t num_fills,   /* Input: number of fill values (or the most to find), up to 4 */
+    int options,        /* Input: a combination of MKIT_BZ_* options, or 0 */
+    void** output);     /* Output: compressed form of input; decode with mkit_inv_bitmask_zero() */
+
+/*
+ * Byte shuffle groups bytes (or bits) of the same significance of all values together,
+ * which makes the data friendlier to general-purpose lossless compressors.
+ */
+#define MKIT_SHUFFLE_BIT_PLANE 1 /* Group bits instead of bytes */
+#define MKIT_SHUFFLE_XOR_DELTA 2 /* XOR each value with its predecessor first */
+
+int mkit_byte_shuffle(
+    const void* inbuf,  /* Input: a buffer of double or float values */
+    int is_float,       /* Input: data type: 1 == float, 0 == double */
+    size_t len,         /* Input: number of values in buf */
+    int flags,          /* Input: a combination of MKIT_SHUFFLE_* flags, or 0 */
+    void** output);     /* Output: shuffled values together with a small header */
+
+int mkit_inv_byte_shuffle(
+    const void* inbuf,  /* Input: the shuffled data produced by mkit_byte_shuffle() */
+    void** output);     /* Output: the recovered original data */
+
+size_t mkit_byte_shuffle_buf_len(
+    const void* inbuf); /* Input: the shuffled data produced by mkit_byte_shuffle() */
+
+/*
+ * Out-of-place variants of the conditioning operations above. They read `inbuf` in one
+ * precision and write `outbuf` in another precision in the same pass, so there is no need
+ * to keep a converted copy of the volume around. The meta data they produce and consume
+ * is exactly the same as their in-place counterparts.
+ */
+int mkit_smart_log_mixed(
+    const void* inbuf,  /* Input: a buffer of double or float values */
+    int in_is_float,    /* Input: data type of inbuf: 1 == float, 0 == double */
+    void* outbuf,       /* Output: a buffer of double or float values, same length as inbuf */
+    int out_is_float,   /* Input: data type of outbuf: 1 == float, 0 == double */
+    size_t buf_len,     /* Input: number of values in inbuf and outbuf */
+    void** meta);       /* Output: the meta data needed to perform a mkit_smart_exp() */
+
+int mkit_smart_log_mixed_ex(
+    const void* inbuf,  /* Input: a buffer of double or float values */
+    int in_is_float,    /* Input: data type of inbuf: 1 == float, 0 == double */
+    void* outbuf,       /* Output: a buffer of double or float values, same length as inbuf */
+    int out_is_float,   /* Input: data type of outbuf: 1 == float, 0 == double */
+    size_t buf_len,     /* Input: number of values in inbuf and outbuf */
+    int options,        /* Input: a combination of MKIT_LOG_* options, or 0 */
+    void** meta);       /* Output: the meta data needed to perform a mkit_smart_exp() */
+
+int mkit_smart_exp_mixed(
+    const void* inbuf,  /* Input: a buffer of double or float values */
+    int in_is_float,    /* Input: data type of inbuf: 1 == float, 0 == double */
+    void* outbuf,       /* Output: a buffer of double or float values, same length as inbuf */
+    int out_is_float,   /* Input: data type of outbuf: 1 == float, 0 == double */
+    size_t buf_len,     /* Input: number of values in inbuf and outbuf */
+    const void* meta);  /* Input: meta data generated by mkit_smart_log() */
+
+int mkit_slice_norm_mixed(
+    const void* inbuf,  /* Input: a buffer of double or float values */
+    int in_is_float,    /* Input: data type of inbuf: 1 == float, 0 == double */
+    void* outbuf,       /* Output: a buffer of double or float values, same length as inbuf */
+    int out_is_float,   /* Input: data type of outbuf: 1 == float, 0 == double */
+    size_t dim_fast,    /* Input: number of values in the fastest varying dimension */
+    size_t dim_mid,     /* Input: number of values in the middle dimension */
+    size_t dim_slow,    /* Input: number of values in the slowest varying dimension */
+    void** meta);       /* Output: the meta data needed to perform a mkit_inv_slice_norm() */
+
+int mkit_inv_slice_norm_mixed(
+    const void* inbuf,  /* Input: a buffer of double or float values */
+    int in_is_float,    /* Input: data type of inbuf: 1 == float, 0 == double */
+    void* outbuf,       /* Output: a buffer of double or float values, same length as inbuf */
+    int out_is_float,   /* Input: data type of outbuf: 1 == float, 0 == double */
+    size_t dim_fast,    /* Input: number of values in the fastest varying dimension */
+    size_t dim_mid,     /* Input: number of values in the middle dimension */
+    size_t dim_slow,    /* Input: number of values in the slowest varying dimension */
+    const void* meta);  /* Input: the meta data generated by mkit_slice_norm() */
+
+/*
+ * Temporal delta encodes a field as its residual against a reference snapshot of the same
+ * field, which is kept in a library-managed cache keyed by field names. Every
+ * `keyframe_interval`-th snapshot is a keyframe that is left unchanged and becomes the new
+ * reference. Keyframes need to be decoded before the snapshots that refer to them.
+ * Prediction is closed-loop: a keyframe only becomes the encoder's reference once its
+ * reconstruction, i.e., the values that the decoder will see, is passed to
+ * mkit_set_temporal_reference(); lossless pipelines pass the keyframe itself. Until then,
+ * every snapshot of the field is encoded as a keyframe.
+ * MKIT_DELTA_RATIO produces value / reference; applying mkit_smart_log() afterwards yields
+ * the residual in log space.
+ */
+#define MKIT_DELTA_DIFF 0  /* residual = value - reference */
+#define MKIT_DELTA_RATIO 1 /* residual = value / reference (unchanged where reference is 0) */
+
+int mkit_temporal_delta(
+    void* buf,                  /* Input and Output: a buffer of double or float values */
+    int is_float,               /* Input: data type: 1 == float, 0 == double */
+    size_t buf_len,             /* Input: number of values in buf */
+    const char* field,          /* Input: name of the field, which keys the reference cache */
+    int mode,                   /* Input: MKIT_DELTA_DIFF or MKIT_DELTA_RATIO */
+    uint32_t keyframe_interval, /* Input: one keyframe every this many snapshots */
+    void** meta);               /* Output: the meta data needed to perform an inverse */
+
+int mkit_set_temporal_reference(
+    const void* buf,            /* Input: the reconstructed keyframe, double or float values */
+    int is_float,               /* Input: data type: 1 == float, 0 == double */
+    size_t buf_len,             /* Input: number of values in buf */
+    const char* field,          /* Input: name of the field, which keys the reference cache */
+    const void* meta);          /* Input: meta data of the keyframe from mkit_temporal_delta() */
+
+int mkit_inv_temporal_delta(
+    void* buf,                  /* Input and Output: a buffer of double or float values */
+    int is_float,               /* Input: data type: 1 == float, 0 == double */
+    size_t buf_len,             /* Input: number of values in buf */
+    const char* field,          /* Input: name of the field, which keys the reference cache */
+    const void* meta);          /* Input: meta data generated by mkit_temporal_delta() */
+
+size_t mkit_temporal_meta_len(
+    const void* meta);          /* Input: meta data generated by mkit_temporal_delta() */
+
+void mkit_clear_temporal_cache(
+    const char* field);         /* Input: the field to drop from the cache; NULL drops all */
+
+/*
+ * Asynchronous variants of the conditioning operations. They return a handle immediately,
+ * and the operation runs on a library-owned pool of background threads. The buffer (and
+ * the meta data of inverse operations) must stay valid and untouched until the operation
+ * completes, and output meta data is only valid after completion.
+ *
+ * Upon completion, the optional callback is invoked on a pool thread with the return
+ * value of the operation and `user_data`, e.g., to submit I/O, before the handle becomes
+ * ready. Every handle needs to be released by mkit_async_wait() eventually.
+ * If the operation fails with an exception (e.g., out of memory), the callback is not
+ * invoked; if either of them throws, the handle becomes ready and mkit_async_wait()
+ * returns -1.
+ * These functions return NULL upon invalid input.
+ */
+typedef void (*mkit_callback)(int rtn, void* user_data);
+
+void* mkit_smart_log_async(
+    void* buf,              /* Input and Output: a buffer of double or float values */
+    int is_float,           /* Input: data type: 1 == float, 0 == double */
+    size_t buf_len,         /* Input: number of values in buf */
+    void** meta,            /* Output: the meta data needed to perform a mkit_smart_exp() */
+    mkit_callback callback, /* Input: invoked upon completion, or NULL */
+    void* user_data);       /* Input: passed to callback */
+
+void* mkit_smart_exp_async(
+    void* buf,              /* Input and Output: a buffer of double or float values */
+    int is_float,           /* Input: data type: 1 == float, 0 == double */
+    size_t buf_len,         /* Input: number of values in buf */
+    const void* meta,       /* Input: meta data generated by mkit_smart_log() */
+    mkit_callback callback, /* Input: invoked upon completion, or NULL */
+    void* user_data);       /* Input: passed to callback */
+
+void* mkit_slice_norm_async(
+    void* buf,              /* Input and Output: a buffer of double or float values */
+    int is_float,           /* Input: data type: 1 == float, 0 == double */
+    size_t dim_fast,        /* Input: number of values in the fastest varying dimension */
+    size_t dim_mid,         /* Input: number of values in the middle dimension */
+    size_t dim_slow,        /* Input: number of values in the slowest varying dimension */
+    void** meta,            /* Output: the meta data needed to perform a mkit_inv_slice_norm() */
+    mkit_callback callback, /* Input: invoked upon completion, or NULL */
+    void* user_data);       /* Input: passed to callback */
+
+void* mkit_inv_slice_norm_async(
+    void* buf,              /* Input and Output: a buffer of double or float values */
+    int is_float,           /* Input: data type: 1 == float, 0 == double */
+    size_t dim_fast,        /* Input: number of values in the fastest varying dimension */
+    size_t dim_mid,         /* Input: number of values in the middle dimension */
+    size_t dim_slow,        /* Input: number of values in the slowest varying dimension */
+    const void* meta,       /* Input: the meta data generated by mkit_slice_norm() */
+    mkit_callback callback, /* Input: invoked upon completion, or NULL */
+    void* user_data);       /* Input: passed to callback */
+
+int mkit_async_poll(
+    const void* handle);  /* Input: a handle returned by one of the *_async() functions.   *
+                           * Returns 1 if the operation has completed, and 0 otherwise.    */
+
+int mkit_async_wait(
+    void* handle);        /* Input: a handle returned by one of the *_async() functions,   *
+                           * which is released by this call. Blocks until the operation    *
+                           * completes, and returns the return value of the operation,     *
+                           * or -1 if the operation or the callback threw.                */
+
+int mkit_set_async_limits(
+    size_t max_tasks,         /* Input: max number of operations running concurrently (default 2) */
+    size_t threads_per_task); /* Input: OpenMP threads used by each operation; 0 means the     *
+                               *    available OpenMP threads divided by max_tasks (default)    */
+
+/*
+ * Tune the number of OpenMP threads (and the stride of smart_log) of every operation and
+ * size class on the current machine. Profiles saved by mkit_save_tune_profile() are loaded
+ * upon first use when the environment variable MKIT_TUNE_PROFILE names one.
+ */
+#define MKIT_TUNE_SMART_LOG 0   /* Tuned operations */
+#define MKIT_TUNE_SMART_EXP 1
+#define MKIT_TUNE_SLICE_NORM 2
+#define MKIT_TUNE_INV_SLICE_NORM 3
+#define MKIT_TUNE_NUM_OPS 4
+#define MKIT_TUNE_NUM_CLASSES 5 /* Size classes, bounded by 2^14, 2^17, 2^20, and 2^23 values */
+
+int mkit_tune(
+    size_t max_len);        /* Input: benchmark size classes whose representative lengths  *
+                             *    do not exceed max_len; other classes are left unchanged  */
+
+int mkit_save_tune_profile(
+    const char* filename);  /* Input: name of the profile file to write */
+
+int mkit_load_tune_profile(
+    const char* filename);  /* Input: name of the profile file to read. Profiles tuned on a  *
+                             *    machine with a different number of processors are rejected */
+
+size_t mkit_tune_class_len(
+    size_t size_class);     /* Input: a size class. Returns its representative length */
+
+int mkit_tuned_params(
+    int op,                 /* Input: one of MKIT_TUNE_* operations */
+    size_t len,             /* Input: number of values of a field */
+    size_t* stride,         /* Output: number of values that a task works on (smart_log only) */
+    int* num_threads);      /* Output: number of OpenMP threads to use */
+
+/*
+ * A mask store deduplicates the masks of many buffers, e.g., the meta data of
+ * mkit_smart_log() and the outputs of mkit_bitmask_zero() of related fields and snapshots.
+ * Mask regions are split in blocks of 512 bytes, and identical blocks are kept only once.
+ * A serialized store is self-describing, and buffers are restored from it in place.
+ */
+void* mkit_mask_store_create(void);     /* Returns an empty store */
+void mkit_mask_store_destroy(void* store);
+
+int mkit_mask_store_add(
+    void* store,          /* Input and Output: a handle returned by mkit_mask_store_create() */
+    const void* buf,      /* Input: a buffer with a mask region */
+    size_t len,           /* Input: number of bytes of buf */
+    size_t mask_begin,    /* Input: the mask region is bytes [mask_begin, mask_end) of buf */
+    size_t mask_end,
+    size_t* id);          /* Output: identifier of buf in the store */
+
+int mkit_mask_store_add_log_meta(
+    void* store,          /* Input and Output: a handle returned by mkit_mask_store_create() */
+    const void* meta,     /* Input: meta data generated by mkit_smart_log() */
+    size_t* id);          /* Output: identifier of meta in the store */
+
+int mkit_mask_store_add_bitmask_zero(
+    void* store,          /* Input and Output: a handle returned by mkit_mask_store_create() */
+    const void* output,   /* Input: output of mkit_bitmask_zero() or mkit_bitmask_value(), *
+                           *        without MKIT_BZ_ADAPTIVE, which is rejected           */
+    size_t* id);          /* Output: identifier of output in the store */
+
+int mkit_mask_store_serialize(
+    const void* store,    /* Input: a handle returned by mkit_mask_store_create() */
+    void** buf,           /* Output: the serialized store; the caller needs to free() it */
+    size_t* len);         /* Output: number of bytes of buf */
+
+size_t mkit_mask_store_buffer_len(
+    const void* buf,      /* Input: a serialized store */
+    size_t id);           /* Input: identifier of a buffer. Returns its number of bytes */
+
+int mkit_mask_store_retrieve(
+    const void* buf,      /* Input: a serialized store */
+    size_t id,            /* Input: identifier of a buffer */
+    void* dst);           /* Output: the restored buffer, of mkit_mask_store_buffer_len() bytes */
+
+/*
+ * Read and write .mkit containers, which keep multiple conditioned fields and their meta
+ * data in a single file. See Container.h for the file layout.
+ */
+#define MKIT_OP_SMART_LOG 1    /* Operation identifiers used in the operation chain of */
+#define MKIT_OP_SLICE_NORM 2   /* a field. They are recorded in the order that the     */
+#define MKIT_OP_BITMASK_ZERO 3 /* operations were applied.                             */
+#define MKIT_OP_TILE_NORM 4
+#define MKIT_OP_SMART_ASINH 5
+#define MKIT_OP_PREVIEW 6      /* The payload is a preview pyramid (see mkit_preview_len()) */
+                               /* of a field of the recorded dimensions, not the field.   */
+
+void* mkit_container_create(
+    const char* filename);  /* Input: name of the container file to create.              *
+                             * Returns a writer handle, or NULL upon failure.            */
+
+int mkit_container_add_field(
+    void* writer,           /* Input: a handle returned by mkit_container_create() */
+    const char* name,       /* Input: a unique name of this field */
+    int is_float,           /* Input: data type: 1 == float, 0 == double */
+    size_t dim_fast,        /* Input: number of values in the fastest varying dimension */
+    size_t dim_mid,         /* Input: number of values in the middle dimension */
+    size_t dim_slow,        /* Input: number of values in the slowest varying dimension */
+    const uint8_t* ops,     /* Input: MKIT_OP_* identifiers of applied operations, in order */
+    size_t num_ops,         /* Input: number of identifiers in ops (up to 255) */
+    const void* payload,    /* Input: the conditioned data */
+    size_t payload_len,     /* Input: number of bytes of payload */
+    const void* meta,       /* Input: meta data of the conditioning operations, or NULL */
+    size_t meta_len);       /* Input: number of bytes of meta */
+
+int mkit_container_finish(
+    void* writer);          /* Input: a writer handle, which is released by this call */
+
+void* mkit_container_open(
+    const char* filename);  /* Input: name of the container file to read.                *
+                             * Returns a reader handle, or NULL upon failure.            */
+
+int mkit_container_find_field(
+    const void* reader,     /* Input: a handle returned by mkit_container_open() */
+    const char* name,       /* Input: name of the field to find */
+    int* is_float,          /* Output: data type: 1 == float, 0 == double */
+    size_t* dims,           /* Output: three dimensions, from the fastest to the slowest */
+    uint8_t* ops,           /* Output: operation chain (room for 255 values), or NULL */
+    size_t* num_ops,        /* Output: number of operations in the chain */
+    const void** payload,   /* Output: pointer to the conditioned data */
+    size_t* payload_len,    /* Output: number of bytes of payload */
+    const void** meta,      /* Output: pointer to the meta data */
+    size_t* meta_len);      /* Output: number of bytes of meta */
+                            /* Note: payload and meta point to memory owned by the reader, *
+                             *       and become invalid after mkit_container_close().      */
+
+void mkit_container_close(
+    void* reader);          /* Input: a reader handle, which is released by this call */
+
 #ifdef __cplusplus
 } /* end of extern "C" */
 }; /* end of namespace C_API */
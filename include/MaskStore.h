@@ -0,0 +1,127 @@
+#ifndef MASK_STORE_H
+#define MASK_STORE_H
+
+/*
+ * MaskStore deduplicates the masks of many buffers, e.g., the meta data of smart_log() or
+ *   the outputs of bitmask_zero() of related fields and of consecutive snapshots, which
+ *   often share their zero regions and change little over time.
+ *
+ * Every buffer added to a store has a mask region. That region is split in blocks of
+ *   `block_len` bytes, which are hashed and kept only once in the store, while the rest of
+ *   the buffer is kept verbatim. A buffer then only records references to its blocks.
+ *   Blocks are compared byte by byte upon a hash match, so that no two different blocks are
+ *   ever merged.
+ *
+ * serialize() lays out a store in a single self-describing buffer. MaskStoreView reads
+ *   such a buffer in place: retrieve() restores a buffer directly into the caller's memory,
+ *   and read_long() reads a word of a mask region by resolving its block reference, so that
+ *   masks can also be queried without restoring them. bitmask() returns a MaskStoreBitmask,
+ *   which has the read functions of BitmaskView over a mask within a mask region, e.g., the
+ *   sign or the zero mask of smart_log() meta data.
+ *
+ * The decoders of the library, e.g., smart_exp() and inv_bitmask_zero(), take contiguous
+ *   buffers, so a buffer needs to be restored with retrieve() before they can decode it.
+ *
+ * The store layout:
+ *   store_len (uint64_t) + num_buffers (uint64_t) + num_blocks (uint64_t) + block_len (uint64_t) +
+ *   for each buffer: offset of its record (uint64_t) +
+ *   unique blocks (block_len bytes each) +
+ *   for each buffer, its record: len (uint64_t) + mask_begin (uint64_t) + mask_end (uint64_t) +
+ *     block references (uint64_t each) + bytes outside of the mask region (padded to 8 bytes)
+ *   The last block of a mask region is padded with zeros.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace mkit {
+
+class MaskStore {
+ public:
+  static constexpr size_t block_len = 512;  // In bytes, i.e., 4096 bits.
+
+  // Functions for adding buffers. They return 0 upon success, and fill in `id`, which
+  //   identifies the buffer in the store.
+  //
+  auto add(const void* buf, size_t len, size_t mask_begin, size_t mask_end, size_t* id) -> int;
+  auto add_log_meta(const void* meta, size_t* id) -> int;        // Masks of smart_log()
+  auto add_bitmask_zero(const void* output, size_t* id) -> int;  // Mask of bitmask_zero()
+                                                                 //   (not with BZ_ADAPTIVE)
+
+  // Functions for queries
+  //
+  auto num_buffers() const -> size_t;
+  auto num_blocks() const -> size_t;         // Number of referenced blocks
+  auto num_unique_blocks() const -> size_t;  // Number of blocks that are kept
+  auto serialize() const -> std::vector<uint8_t>;
+
+ private:
+  struct Record {
+    std::vector<uint8_t> rest;  // Bytes outside of the mask region
+    std::vector<uint64_t> refs;
+    uint64_t len = 0;
+    uint64_t mask_begin = 0;
+    uint64_t mask_end = 0;
+  };
+
+  std::vector<uint8_t> m_blocks;
+  std::unordered_multimap<uint64_t, uint64_t> m_index;  // Hash to block number
+  std::vector<Record> m_records;
+  size_t m_num_refs = 0;
+};
+
+// Reads a mask kept in a store, resolving block references upon every read, with the same
+//   semantics as BitmaskView.
+class MaskStoreBitmask {
+ public:
+  auto size() const -> size_t;  // Num. of useful bits in this mask.
+  auto read_long(size_t idx) const -> uint64_t;
+  auto read_bit(size_t idx) const -> bool;
+
+ private:
+  friend class MaskStoreView;
+  const uint8_t* m_blocks = nullptr;
+  const uint8_t* m_refs = nullptr;
+  size_t m_block_len = 0;
+  size_t m_offset = 0;  // In bytes, relative to the start of the mask region
+  size_t m_num_bits = 0;
+};
+
+class MaskStoreView {
+ public:
+  explicit MaskStoreView(const void* store);
+
+  auto num_buffers() const -> size_t;
+  auto buffer_len(size_t id) const -> size_t;  // In number of bytes
+  auto retrieve(size_t id, void* dst) const -> int;
+
+  // Read 64 bits of the mask region of a buffer, where `idx` is a bit position relative to
+  //   the start of that region, with the same semantics as Bitmask::read_long().
+  auto read_long(size_t id, size_t idx) const -> uint64_t;
+
+  // A mask of `num_bits` bits that starts `offset` bytes into the mask region of a buffer.
+  //   `offset` needs to be a multiple of 8, as masks are made of 64-bit words.
+  auto bitmask(size_t id, size_t offset, size_t num_bits) const -> MaskStoreBitmask;
+
+ private:
+  struct Entry {
+    const uint8_t* refs = nullptr;
+    const uint8_t* rest = nullptr;
+    uint64_t len = 0;
+    uint64_t mask_begin = 0;
+    uint64_t mask_end = 0;
+  };
+
+  auto entry(size_t id) const -> Entry;
+
+  const uint8_t* m_ptr = nullptr;
+  const uint8_t* m_blocks = nullptr;
+  size_t m_num_buffers = 0;
+  size_t m_block_len = 0;
+};
+
+};  // namespace mkit
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef SKETCH_H
+#define SKETCH_H
+
+/*
+ * Sketch is a fixed-size, log-spaced histogram that also serves as a mergeable quantile
+ *   sketch. A value is binned by its single-precision representation: its sign, its 8
+ *   exponent bits, and its top 4 mantissa bits. Each bin then spans a relative width of at
+ *   most 1/16, and a quantile is reported as the midpoint of the bin it falls in, so the
+ *   relative error of a quantile is within 1/32 (apart from values that fall out of the
+ *   range of single-precision values).
+ *
+ * Bins are numbered in increasing order of their values: bins [0, num_bins / 2) hold
+ *   negative values, and bins [num_bins / 2, num_bins) hold non-negative values. The
+ *   outermost bins of each half hold infinities (and values that overflow single
+ *   precision). NaNs are only counted, and not kept in any bin.
+ *
+ * Sketches of different parts of a field, or of different ranks, can be merged into one
+ *   with merge(), which gives the same result as sketching all values together.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mkit {
+
+class Sketch {
+ public:
+  static constexpr size_t num_bins = 2 * 256 * 16;
+
+  // Constructor
+  //
+  Sketch();
+
+  // Functions for accumulation
+  //
+  void add(double val);
+  template <typename T>
+  void add(const T* buf, size_t len);  // Sketch many values in parallel.
+  void merge(const Sketch& other);
+  void clear();
+
+  // Functions for queries
+  //
+  auto count() const -> uint64_t;  // Number of binned values, i.e., excluding NaNs.
+  auto num_nan() const -> uint64_t;
+  auto quantile(double q) const -> double;  // q in [0, 1]; NaN if the sketch is empty.
+  auto histogram() const -> const std::vector<uint64_t>&;
+  static auto bin_of(double val) -> size_t;
+  static auto bin_lower(size_t bin) -> double;  // The smallest value that falls in a bin.
+  static auto bin_upper(size_t bin) -> double;  // The largest value that falls in a bin.
+
+ private:
+  std::vector<uint64_t> m_counts;
+  uint64_t m_num_nan = 0;
+};
+
+};  // namespace mkit
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef TUNE_H
+#define TUNE_H
+
+/*
+ * Tuning of kernel parameters on the current machine. Kernels look up their parameters by
+ *   operation and size class: the number of OpenMP threads to use, and for smart_log(), the
+ *   number of values that a task works on (its stride). Small fields are often better off
+ *   with fewer threads, as the cost of forking and joining dominates.
+ *
+ * tune() benchmarks the candidate parameters of every operation on synthetic data of a
+ *   representative length of every size class, and keeps the fastest ones. The results can
+ *   be saved to a small text profile, which is loaded by the library upon first use when
+ *   the environment variable MKIT_TUNE_PROFILE names it, or explicitly with
+ *   load_tune_profile(). A profile records the number of processors of the machine that it
+ *   was tuned on, and is rejected on a machine with a different number.
+ *
+ * Without a profile, kernels use all available OpenMP threads and a stride of 16384 values.
+ *   Parameters are global to the process; they should not be changed while other
+ *   operations are running.
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mkit {
+
+// Tuned operations
+//
+constexpr uint8_t TUNE_SMART_LOG = 0;
+constexpr uint8_t TUNE_SMART_EXP = 1;
+constexpr uint8_t TUNE_SLICE_NORM = 2;
+constexpr uint8_t TUNE_INV_SLICE_NORM = 3;
+constexpr size_t tune_num_ops = 4;
+
+// Size classes are bounded by powers of 8 of the number of values: class 0 holds fields of
+//   fewer than 2^14 values, class 1 fewer than 2^17, and so on, while the last class holds
+//   all fields of at least 2^23 values.
+//
+constexpr size_t tune_num_classes = 5;
+
+struct TuneParams {
+  size_t stride = 16384;  // Must be a positive multiple of 64; rounded up to a multiple of
+                          //   log_block_len when smart_log() builds a block index.
+  int num_threads = 0;    // 0 means all available OpenMP threads.
+};
+
+auto tune_size_class(size_t len) -> size_t;
+auto tune_class_len(size_t size_class) -> size_t;  // The representative length of a class
+
+// Parameters to use for an operation on `len` values. The number of threads is resolved to
+//   an actual count, which never exceeds the available OpenMP threads.
+auto tuned_params(uint8_t op, size_t len) -> TuneParams;
+auto set_tuned_params(uint8_t op, size_t size_class, TuneParams params) -> int;
+
+// Benchmark all size classes whose representative lengths do not exceed `max_len`;
+//   other classes keep their parameters. Returns 0 upon success.
+auto tune(size_t max_len) -> int;
+auto save_tune_profile(const char* filename) -> int;
+auto load_tune_profile(const char* filename) -> int;
+
+};  // namespace mkit
+
+#endif
@@ -0,0 +1,214 @@
+#include "MURaMKit.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// Stream definition:
+// for each block: its type (uint8_t), padded to a multiple of 8 bytes +
+//   for each block: byte offset of its end, relative to the first payload (uint64_t) +
+//   for each block: its payload, padded to a multiple of 8 bytes
+//
+// Every block covers `block_bits` bits of the mask (fewer for the last one), and takes the
+//    smallest one of the following encodings:
+//    - all bits set or all bits unset: no payload;
+//    - the bitmask words verbatim;
+//    - a list of the positions of set bits, or of unset bits, whichever are fewer: their
+//      count (uint16_t), followed by the gaps between consecutive positions, each in one
+//      byte if it is below 128, or two bytes otherwise.
+//
+constexpr size_t block_bits = 4096;
+constexpr size_t block_words = block_bits / 64;
+
+constexpr uint8_t block_all_set = 0;
+constexpr uint8_t block_all_unset = 1;
+constexpr uint8_t block_bitmask = 2;
+constexpr uint8_t block_list_set = 3;
+constexpr uint8_t block_list_unset = 4;
+
+auto pad8(size_t len) -> size_t
+{
+  return (len + 7) / 8 * 8;
+}
+
+// Number of bytes of a list of the positions of the set bits of `words`.
+auto list_len(const uint64_t* words, size_t num_words) -> size_t
+{
+  size_t len = sizeof(uint16_t);
+  size_t prev = 0;  // One past the previous position
+  for (size_t w = 0; w < num_words; w++)
+    for (auto word = words[w]; word; word &= word - 1) {
+      const size_t pos = w * 64 + std::countr_zero(word);
+      len += (pos - prev < 128) ? 1 : 2;
+      prev = pos + 1;
+    }
+  return len;
+}
+
+void write_list(const uint64_t* words, size_t num_words, size_t count, uint8_t* dst)
+{
+  const auto cnt16 = uint16_t(count);
+  std::memcpy(dst, &cnt16, sizeof(cnt16));
+  dst += sizeof(cnt16);
+  size_t prev = 0;
+  for (size_t w = 0; w < num_words; w++)
+    for (auto word = words[w]; word; word &= word - 1) {
+      const size_t pos = w * 64 + std::countr_zero(word);
+      const size_t gap = pos - prev;
+      if (gap < 128)
+        *dst++ = uint8_t(gap);
+      else {
+        *dst++ = uint8_t(0x80 | (gap & 0x7F));
+        *dst++ = uint8_t(gap >> 7);
+      }
+      prev = pos + 1;
+    }
+}
+
+void read_list(const uint8_t* src, uint64_t* words)
+{
+  uint16_t count = 0;
+  std::memcpy(&count, src, sizeof(count));
+  src += sizeof(count);
+  size_t pos = 0;
+  for (size_t k = 0; k < count; k++) {
+    size_t gap = *src++;
+    if (gap & 0x80)
+      gap = (gap & 0x7F) | (size_t(*src++) << 7);
+    pos += gap;
+    words[pos / 64] |= uint64_t{1} << (pos % 64);
+    pos++;
+  }
+}
+
+};  // namespace
+
+auto mkit::adaptive_mask_encode(const uint64_t* words, size_t num_bits) -> std::vector<uint8_t>
+{
+  const size_t num_words = (num_bits + 63) / 64;
+  const size_t num_blocks = (num_bits + block_bits - 1) / block_bits;
+  auto types = std::vector<uint8_t>(num_blocks);
+  auto payloads = std::vector<std::vector<uint8_t>>(num_blocks);
+
+#pragma omp parallel for
+  for (size_t blk = 0; blk < num_blocks; blk++) {
+    const size_t nw = std::min(block_words, num_words - blk * block_words);
+    const size_t nbits = std::min(block_bits, num_bits - blk * block_bits);
+
+    // Copies of the words and of their complements, with bits beyond `num_bits` cleared.
+    auto set = std::array<uint64_t, block_words>{};
+    auto unset = std::array<uint64_t, block_words>{};
+    size_t num_set = 0;
+    for (size_t w = 0; w < nw; w++) {
+      const size_t n = std::min<size_t>(64, nbits - w * 64);
+      const uint64_t valid = (n < 64) ? (uint64_t{1} << n) - 1 : ~uint64_t{0};
+      set[w] = words[blk * block_words + w] & valid;
+      unset[w] = ~words[blk * block_words + w] & valid;
+      num_set += std::popcount(set[w]);
+    }
+
+    auto& payload = payloads[blk];
+    if (num_set == nbits)
+      types[blk] = block_all_set;
+    else if (num_set == 0)
+      types[blk] = block_all_unset;
+    else {
+      const bool fewer_set = num_set * 2 <= nbits;
+      const auto* list_words = fewer_set ? set.data() : unset.data();
+      const size_t llen = list_len(list_words, nw);
+      if (llen < nw * 8) {
+        types[blk] = fewer_set ? block_list_set : block_list_unset;
+        payload.assign(pad8(llen), 0);
+        write_list(list_words, nw, fewer_set ? num_set : nbits - num_set, payload.data());
+      }
+      else {
+        types[blk] = block_bitmask;
+        payload.resize(nw * 8);
+        std::memcpy(payload.data(), words + blk * block_words, nw * 8);
+      }
+    }
+  }
+
+  // Lay out the types and the directory, and then copy all payloads to their places.
+  const size_t types_len = pad8(num_blocks);
+  const size_t dir_len = sizeof(uint64_t) * num_blocks;
+  auto ends = std::vector<uint64_t>(num_blocks);
+  uint64_t end = 0;
+  for (size_t blk = 0; blk < num_blocks; blk++) {
+    end += payloads[blk].size();
+    ends[blk] = end;
+  }
+  auto stream = std::vector<uint8_t>(types_len + dir_len + end, 0);
+  std::memcpy(stream.data(), types.data(), num_blocks);
+  std::memcpy(stream.data() + types_len, ends.data(), dir_len);
+
+#pragma omp parallel for
+  for (size_t blk = 0; blk < num_blocks; blk++) {
+    const uint64_t begin = (blk == 0) ? 0 : ends[blk - 1];
+    std::memcpy(stream.data() + types_len + dir_len + begin, payloads[blk].data(),
+                payloads[blk].size());
+  }
+
+  return stream;
+}
+
+void mkit::adaptive_mask_decode(const void* input, size_t num_bits, uint64_t* words)
+{
+  const uint8_t* const p = static_cast<const uint8_t*>(input);
+  const size_t num_words = (num_bits + 63) / 64;
+  const size_t num_blocks = (num_bits + block_bits - 1) / block_bits;
+  const size_t types_len = pad8(num_blocks);
+  const uint8_t* const payloads = p + types_len + sizeof(uint64_t) * num_blocks;
+
+#pragma omp parallel for
+  for (size_t blk = 0; blk < num_blocks; blk++) {
+    uint64_t begin = 0;
+    if (blk > 0)
+      std::memcpy(&begin, p + types_len + sizeof(uint64_t) * (blk - 1), sizeof(begin));
+    const size_t nw = std::min(block_words, num_words - blk * block_words);
+    uint64_t* const dst = words + blk * block_words;
+    switch (p[blk]) {
+      case block_all_set:
+        std::fill(dst, dst + nw, ~uint64_t{0});
+        break;
+      case block_all_unset:
+        std::fill(dst, dst + nw, uint64_t{0});
+        break;
+      case block_bitmask:
+        std::memcpy(dst, payloads + begin, nw * 8);
+        break;
+      case block_list_set:
+        std::fill(dst, dst + nw, uint64_t{0});
+        read_list(payloads + begin, dst);
+        break;
+      default:  // block_list_unset
+        std::fill(dst, dst + nw, uint64_t{0});
+        read_list(payloads + begin, dst);
+        for (size_t w = 0; w < nw; w++)
+          dst[w] = ~dst[w];
+    }
+  }
+}
+
+auto mkit::retrieve_adaptive_mask_len(const void* input, size_t num_bits) -> size_t
+{
+  const size_t num_blocks = (num_bits + block_bits - 1) / block_bits;
+  if (num_blocks == 0)
+    return 0;
+  const size_t types_len = pad8(num_blocks);
+  uint64_t end = 0;
+  std::memcpy(&end, static_cast<const uint8_t*>(input) + types_len +
+                        sizeof(uint64_t) * (num_blocks - 1), sizeof(end));
+  return types_len + sizeof(uint64_t) * num_blocks + end;
+}
+
+auto mkit::calc_adaptive_mask_max_len(size_t num_bits) -> size_t
+{
+  // No block takes more than its bitmask words.
+  const size_t num_blocks = (num_bits + block_bits - 1) / block_bits;
+  return pad8(num_blocks) + sizeof(uint64_t) * num_blocks + (num_bits + 63) / 64 * 8;
+}
@@ -0,0 +1,167 @@
+#include "MURaMKit.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+template <typename T>
+auto mkit::analyze(const T* buf, size_t len, Analysis* result) -> int
+{
+  if (result == nullptr)
+    return 1;
+
+  const auto eps = T{1e-11};  // Same threshold as bitmask_zero()
+  const auto inf = std::numeric_limits<T>::infinity();
+  auto min = inf, max = -inf;
+  size_t num_neg = 0, num_zero = 0, num_near_zero = 0, num_nan = 0, num_inf = 0;
+
+#pragma omp parallel for simd reduction(+ : num_neg, num_zero, num_near_zero, num_nan, num_inf) \
+    reduction(min : min) reduction(max : max)
+  for (size_t i = 0; i < len; i++) {
+    const T v = buf[i];
+    const T a = std::abs(v);
+    const bool is_nan = (v != v);
+    const bool is_inf = (a == inf);
+    num_neg += (v < T{0});
+    num_zero += (v == T{0});
+    num_near_zero += (a <= eps);
+    num_nan += is_nan;
+    num_inf += is_inf;
+    if (!is_nan && !is_inf) {
+      min = std::min(min, v);
+      max = std::max(max, v);
+    }
+  }
+
+  *result = Analysis();
+  result->num_neg = num_neg;
+  result->num_zero = num_zero;
+  result->num_near_zero = num_near_zero;
+  result->num_finite = len - num_nan - num_inf;
+  result->num_nan = num_nan;
+  result->num_inf = num_inf;
+  if (result->num_finite > 0) {
+    result->min = min;
+    result->max = max;
+  }
+
+  // Predict output sizes of each operation.
+  //   Note that bitmask_zero() treats NaNs as zeros too.
+  const bool has_neg = num_neg > 0, has_zero = num_zero > 0;
+  const auto treatment =
+      pack_8_booleans({has_neg, has_zero, has_neg && has_zero, false, false, false, false, false});
+  result->log_meta_len = calc_log_meta_len(len, treatment);
+  result->bitmask_zero_buf_len =
+      calc_bitmask_zero_buf_len(len, len - num_near_zero - num_nan, sizeof(T), 0);
+  result->byte_shuffle_buf_len = 10 + calc_shuffle_len(len, sizeof(T), 0);
+  result->temporal_meta_len = mkit::temporal_meta_len;
+
+  return 0;
+}
+template auto mkit::analyze(const float*, size_t, Analysis*) -> int;
+template auto mkit::analyze(const double*, size_t, Analysis*) -> int;
+
+template <typename T>
+auto mkit::compare(const T* a, const T* b, size_t len, double threshold, Metrics* result) -> int
+{
+  if (result == nullptr)
+    return 1;
+
+  // Every task works on a chunk of values with vectorized reductions, and only when the
+  //    maximum error of its chunk is a new record for the task, it locates that error in
+  //    the chunk, which is still in cache.
+  const size_t chunk = 4096;
+  const size_t num_chunks = (len + chunk - 1) / chunk;
+  const auto inf = std::numeric_limits<double>::infinity();
+  auto sum_sq = 0.0, sum_diff = 0.0, min = inf, max = -inf;
+  size_t num_over = 0, num_compared = 0, num_mismatch = 0;
+  auto best = Metrics{-1.0, 0, -1.0, 0};  // Errors of -1 until a pair is compared.
+
+#pragma omp parallel reduction(+ : sum_sq, sum_diff, num_over, num_compared, num_mismatch) \
+    reduction(min : min) reduction(max : max)
+  {
+    auto my_abs = -1.0, my_rel = -1.0;
+    size_t my_abs_idx = 0, my_rel_idx = 0;
+
+#pragma omp for
+    for (size_t c = 0; c < num_chunks; c++) {
+      const size_t begin = c * chunk, end = std::min(len, begin + chunk);
+      auto chunk_abs = -1.0, chunk_rel = -1.0;
+
+#pragma omp simd reduction(+ : sum_sq, sum_diff, num_over, num_compared, num_mismatch) \
+    reduction(min : min) reduction(max : max, chunk_abs, chunk_rel)
+      for (size_t i = begin; i < end; i++) {
+        const auto x = double(a[i]), y = double(b[i]);
+        const bool ok = std::isfinite(x) && std::isfinite(y);
+        num_compared += ok;
+        num_mismatch += !ok && !(x == y || (x != x && y != y));
+        const auto d = ok ? y - x : 0.0;
+        const auto e = ok ? std::abs(d) : -1.0;
+        const auto r = (ok && x != 0.0) ? e / std::abs(x) : -1.0;
+        sum_sq += d * d;
+        sum_diff += d;
+        num_over += (ok && e > threshold);
+        min = std::min(min, ok ? x : inf);
+        max = std::max(max, ok ? x : -inf);
+        chunk_abs = std::max(chunk_abs, e);
+        chunk_rel = std::max(chunk_rel, r);
+      }
+
+      if (chunk_abs > my_abs) {
+        my_abs = chunk_abs;
+        for (size_t i = begin; i < end; i++) {
+          const auto x = double(a[i]), y = double(b[i]);
+          if (std::isfinite(x) && std::isfinite(y) && std::abs(y - x) == chunk_abs) {
+            my_abs_idx = i;
+            break;
+          }
+        }
+      }
+      if (chunk_rel > my_rel) {
+        my_rel = chunk_rel;
+        for (size_t i = begin; i < end; i++) {
+          const auto x = double(a[i]), y = double(b[i]);
+          if (std::isfinite(x) && std::isfinite(y) && x != 0.0 &&
+              std::abs(y - x) / std::abs(x) == chunk_rel) {
+            my_rel_idx = i;
+            break;
+          }
+        }
+      }
+    }
+
+    // Ties go to the lower index, so that the result does not depend on scheduling.
+#pragma omp critical
+    {
+      if (my_abs > best.max_abs_err ||
+          (my_abs == best.max_abs_err && my_abs_idx < best.max_abs_idx)) {
+        best.max_abs_err = my_abs;
+        best.max_abs_idx = my_abs_idx;
+      }
+      if (my_rel > best.max_rel_err ||
+          (my_rel == best.max_rel_err && my_rel_idx < best.max_rel_idx)) {
+        best.max_rel_err = my_rel;
+        best.max_rel_idx = my_rel_idx;
+      }
+    }
+  }
+
+  *result = Metrics();
+  result->num_over_threshold = num_over;
+  result->num_compared = num_compared;
+  result->num_nonfinite_mismatch = num_mismatch;
+  if (num_compared > 0) {
+    result->max_abs_err = best.max_abs_err;
+    result->max_abs_idx = best.max_abs_idx;
+    result->max_rel_err = std::max(best.max_rel_err, 0.0);
+    result->max_rel_idx = best.max_rel_idx;
+    result->rmse = std::sqrt(sum_sq / double(num_compared));
+    result->bias = sum_diff / double(num_compared);
+    result->psnr = (result->rmse == 0.0) ? inf : 20.0 * std::log10((max - min) / result->rmse);
+  }
+
+  return 0;
+}
+template auto mkit::compare(const float*, const float*, size_t, double, Metrics*) -> int;
+template auto mkit::compare(const double*, const double*, size_t, double, Metrics*) -> int;
@@ -0,0 +1,142 @@
+#include "MURaMKit.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace {
+
+// Meta data definition:
+// buf_len (uint64_t) + scale (double)
+//
+constexpr size_t meta_len = 16;
+
+// The binary exponent of a nonzero, finite value, read from its bits unless it is subnormal.
+template <typename T>
+inline auto binary_exponent(T v) -> int
+{
+  using uint_type = std::conditional_t<std::is_same_v<T, float>, uint32_t, uint64_t>;
+  constexpr int M = std::numeric_limits<T>::digits - 1;
+  constexpr int bias = std::numeric_limits<T>::max_exponent - 1;
+  const int field = int((std::bit_cast<uint_type>(v) >> M) & uint_type(2 * bias + 1));
+  return field ? field - bias : std::ilogb(v);
+}
+
+};  // namespace
+
+template <typename T>
+auto mkit::smart_asinh(T* buf, size_t buf_len, void** meta) -> int
+{
+  return smart_asinh(static_cast<const T*>(buf), buf, buf_len, meta);
+}
+template auto mkit::smart_asinh(float*, size_t, void**) -> int;
+template auto mkit::smart_asinh(double*, size_t, void**) -> int;
+
+template <typename T1, typename T2>
+auto mkit::smart_asinh(const T1* input, T2* output, size_t buf_len, void** meta) -> int
+{
+  if (*meta != nullptr)
+    return 1;
+
+  using calc_type = std::common_type_t<T1, T2>;
+
+  // Step 1: mean and standard deviation of binary exponents of nonzero, finite values.
+  //
+  double sum = 0.0, sum2 = 0.0;
+  size_t count = 0;
+  int max_exp = std::numeric_limits<int>::min();
+#pragma omp parallel for simd reduction(+ : sum, sum2, count) reduction(max : max_exp)
+  for (size_t i = 0; i < buf_len; i++) {
+    const auto v = input[i];
+    if (v != T1{0} && std::isfinite(v)) {
+      const int e = binary_exponent(v);
+      sum += double(e);
+      sum2 += double(e) * double(e);
+      count++;
+      max_exp = std::max(max_exp, e);
+    }
+  }
+
+  // Step 2: the scale is a power of two, so scaling is exact. It sits two standard
+  //    deviations below the mean exponent, so that most values fall in the logarithmic
+  //    part of asinh, and only the smallest ones in its linear part. It is also kept large
+  //    enough that scaled values, and sinh() of their transforms, do not overflow in the
+  //    precision of the calculation.
+  //
+  double scale = 1.0;
+  if (count > 0) {
+    const double mean = sum / double(count);
+    const double stddev = std::sqrt(std::max(0.0, sum2 / double(count) - mean * mean));
+    const int lo = std::max(std::numeric_limits<T1>::min_exponent - 1,
+                            max_exp - std::numeric_limits<calc_type>::max_exponent + 3);
+    const int hi = std::numeric_limits<T1>::max_exponent - 1;
+    const int e = std::clamp(int(std::floor(mean - 2.0 * stddev)), lo, hi);
+    scale = std::ldexp(1.0, e);
+  }
+
+  // Step 3: transform all values in a single pass.
+  //
+  const auto inv_scale = calc_type(1.0 / scale);
+#pragma omp parallel for simd
+  for (size_t i = 0; i < buf_len; i++)
+    output[i] = T2(std::asinh(calc_type(input[i]) * inv_scale));
+
+  uint8_t* tmp_buf = static_cast<uint8_t*>(std::malloc(meta_len));
+  const auto tmp64 = uint64_t{buf_len};
+  std::memcpy(tmp_buf, &tmp64, sizeof(tmp64));
+  std::memcpy(tmp_buf + sizeof(tmp64), &scale, sizeof(scale));
+  *meta = tmp_buf;
+
+  return 0;
+}
+template auto mkit::smart_asinh(const float*, float*, size_t, void**) -> int;
+template auto mkit::smart_asinh(const float*, double*, size_t, void**) -> int;
+template auto mkit::smart_asinh(const double*, float*, size_t, void**) -> int;
+template auto mkit::smart_asinh(const double*, double*, size_t, void**) -> int;
+
+template <typename T>
+auto mkit::smart_sinh(T* buf, size_t buf_len, const void* meta) -> int
+{
+  return smart_sinh(static_cast<const T*>(buf), buf, buf_len, meta);
+}
+template auto mkit::smart_sinh(float*, size_t, const void*) -> int;
+template auto mkit::smart_sinh(double*, size_t, const void*) -> int;
+
+template <typename T1, typename T2>
+auto mkit::smart_sinh(const T1* input, T2* output, size_t buf_len, const void* meta) -> int
+{
+  const uint8_t* p = static_cast<const uint8_t*>(meta);
+  auto len = uint64_t{0};
+  auto scale = 0.0;
+  std::memcpy(&len, p, sizeof(len));
+  std::memcpy(&scale, p + sizeof(len), sizeof(scale));
+  if (len != buf_len)
+    return 1;
+
+  // Rounding of the largest values may push them past the largest finite value, in which
+  //    case they are clamped. Infinite values stay infinite.
+  using calc_type = std::common_type_t<T1, T2>;
+  const auto s = calc_type(scale);
+  const auto max = calc_type(std::numeric_limits<T2>::max());
+#pragma omp parallel for simd
+  for (size_t i = 0; i < buf_len; i++) {
+    const auto v = calc_type(input[i]);
+    const auto x = std::sinh(v) * s;
+    output[i] = T2(std::isinf(v) ? x : std::clamp(x, -max, max));
+  }
+
+  return 0;
+}
+template auto mkit::smart_sinh(const float*, float*, size_t, const void*) -> int;
+template auto mkit::smart_sinh(const float*, double*, size_t, const void*) -> int;
+template auto mkit::smart_sinh(const double*, float*, size_t, const void*) -> int;
+template auto mkit::smart_sinh(const double*, double*, size_t, const void*) -> int;
+
+auto mkit::retrieve_asinh_meta_len([[maybe_unused]] const void* meta) -> size_t
+{
+  return meta_len;
+}
@@ -0,0 +1,231 @@
+#include "Async.h"
+#include <omp.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// A pool of worker threads that run submitted tasks in FIFO order. Workers are started
+// upon the first submission, and restarted when the limits change. Old workers are joined
+// without holding any lock, so that tasks and callbacks can submit more tasks, or change
+// the limits, while a restart is under way.
+class TaskPool {
+ public:
+  ~TaskPool()
+  {
+    auto old = std::vector<std::thread>();
+    {
+      std::lock_guard<std::mutex> lock(m_config_mutex);
+      old = retire_workers();
+      std::move(m_retired.begin(), m_retired.end(), std::back_inserter(old));
+      m_retired.clear();
+    }
+    join(std::move(old));
+  }
+
+  void submit(std::function<void()> task)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_config_mutex);
+      if (m_workers.empty())
+        start_workers();
+    }
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_queue.push_back(std::move(task));
+    }
+    m_cv.notify_one();
+  }
+
+  auto set_limits(size_t max_tasks, size_t threads_per_task) -> int
+  {
+    if (max_tasks == 0)
+      return 1;
+
+    auto old = std::vector<std::thread>();
+    {
+      std::lock_guard<std::mutex> lock(m_config_mutex);
+      m_max_tasks = max_tasks;
+      m_threads_per_task = threads_per_task;
+      if (!m_workers.empty()) {
+        old = retire_workers();
+        start_workers();
+      }
+      std::move(m_retired.begin(), m_retired.end(), std::back_inserter(old));
+      m_retired.clear();
+    }
+    join(std::move(old));
+    return 0;
+  }
+
+ private:
+  std::mutex m_config_mutex;  // Serializes starting and retiring workers.
+  size_t m_max_tasks = 2;
+  size_t m_threads_per_task = 0;
+  std::vector<std::thread> m_workers;
+  std::vector<std::thread> m_retired;  // Old workers that could not be joined yet
+
+  std::mutex m_mutex;  // Protects the queue and the generation.
+  std::condition_variable m_cv;
+  std::deque<std::function<void()>> m_queue;
+  size_t m_generation = 0;
+
+  void start_workers()
+  {
+    auto num_threads = m_threads_per_task;
+    if (num_threads == 0)
+      num_threads = std::max<size_t>(1, omp_get_max_threads() / m_max_tasks);
+
+    size_t gen = 0;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      gen = m_generation;
+    }
+    for (size_t i = 0; i < m_max_tasks; i++)
+      m_workers.emplace_back([this, gen, num_threads] { work(gen, int(num_threads)); });
+  }
+
+  // Workers of an old generation finish their current task and then exit; queued tasks
+  // are left for the next generation. Returns the old workers, to be joined by the caller
+  // once it no longer holds `m_config_mutex`.
+  auto retire_workers() -> std::vector<std::thread>
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_generation++;
+    }
+    m_cv.notify_all();
+    return std::exchange(m_workers, {});
+  }
+
+  // A worker that changes the limits from within a task cannot join itself; it is kept
+  // and joined upon the next change of limits, or when the pool is destroyed.
+  void join(std::vector<std::thread> threads)
+  {
+    for (auto& t : threads) {
+      if (t.get_id() == std::this_thread::get_id()) {
+        std::lock_guard<std::mutex> lock(m_config_mutex);
+        m_retired.push_back(std::move(t));
+      }
+      else
+        t.join();
+    }
+  }
+
+  void work(size_t gen, int num_threads)
+  {
+    omp_set_num_threads(num_threads);
+    while (true) {
+      auto task = std::function<void()>();
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [&] { return !m_queue.empty() || m_generation != gen; });
+        if (m_generation != gen)
+          return;
+        task = std::move(m_queue.front());
+        m_queue.pop_front();
+      }
+      task();
+    }
+  }
+};
+
+auto pool() -> TaskPool&
+{
+  static auto p = TaskPool();
+  return p;
+}
+
+template <typename Op>
+auto submit(Op&& op, mkit::async_callback callback, void* user_data) -> std::future<int>
+{
+  auto promise = std::make_shared<std::promise<int>>();
+  auto future = promise->get_future();
+  pool().submit([op = std::forward<Op>(op), callback, user_data, promise] {
+    // An exception must not escape a pool thread, which would terminate the process;
+    //    it is handed to whoever waits on the future instead.
+    try {
+      const int rtn = op();
+      if (callback)
+        callback(rtn, user_data);
+      promise->set_value(rtn);
+    }
+    catch (...) {
+      promise->set_exception(std::current_exception());
+    }
+  });
+  return future;
+}
+
+};  // namespace
+
+auto mkit::set_async_limits(size_t max_tasks, size_t threads_per_task) -> int
+{
+  return pool().set_limits(max_tasks, threads_per_task);
+}
+
+template <typename T>
+auto mkit::smart_log_async(T* buf,
+                           size_t buf_len,
+                           void** meta,
+                           async_callback callback,
+                           void* user_data) -> std::future<int>
+{
+  return submit([=] { return smart_log(buf, buf_len, meta); }, callback, user_data);
+}
+template auto mkit::smart_log_async(float*, size_t, void**, async_callback, void*)
+    -> std::future<int>;
+template auto mkit::smart_log_async(double*, size_t, void**, async_callback, void*)
+    -> std::future<int>;
+
+template <typename T>
+auto mkit::smart_exp_async(T* buf,
+                           size_t buf_len,
+                           const void* meta,
+                           async_callback callback,
+                           void* user_data) -> std::future<int>
+{
+  return submit([=] { return smart_exp(buf, buf_len, meta); }, callback, user_data);
+}
+template auto mkit::smart_exp_async(float*, size_t, const void*, async_callback, void*)
+    -> std::future<int>;
+template auto mkit::smart_exp_async(double*, size_t, const void*, async_callback, void*)
+    -> std::future<int>;
+
+template <typename T>
+auto mkit::slice_norm_async(T* buf,
+                            dims_type dims,
+                            void** meta,
+                            async_callback callback,
+                            void* user_data) -> std::future<int>
+{
+  return submit([=] { return slice_norm(buf, dims, meta); }, callback, user_data);
+}
+template auto mkit::slice_norm_async(float*, dims_type, void**, async_callback, void*)
+    -> std::future<int>;
+template auto mkit::slice_norm_async(double*, dims_type, void**, async_callback, void*)
+    -> std::future<int>;
+
+template <typename T>
+auto mkit::inv_slice_norm_async(T* buf,
+                                dims_type dims,
+                                const void* meta,
+                                async_callback callback,
+                                void* user_data) -> std::future<int>
+{
+  return submit([=] { return inv_slice_norm(buf, dims, meta); }, callback, user_data);
+}
+template auto mkit::inv_slice_norm_async(float*, dims_type, const void*, async_callback, void*)
+    -> std::future<int>;
+template auto mkit::inv_slice_norm_async(double*, dims_type, const void*, async_callback, void*)
+    -> std::future<int>;
@@ -95,3 +95,187 @@ void mkit::Bitmask::use_bitstream(const void* p)
   const auto* pu64 = static_cast<const uint64_t*>(p);
   std::copy(pu64, pu64 + m_buf.size(), m_buf.begin());
 }
+
+//
+// Bulk operations
+//
+namespace {
+
+// Below this number of words, parallelization costs more than it saves.
+constexpr size_t parallel_threshold = 1 << 16;
+
+};  // namespace
+
+auto mkit::Bitmask::masked_word(size_t widx) const -> uint64_t
+{
+  auto word = m_buf[widx];
+  if (widx == m_buf.size() - 1 && m_num_bits % 64 != 0)
+    word &= (uint64_t{1} << (m_num_bits % 64)) - 1;
+  return word;
+}
+
+auto mkit::Bitmask::word_or_zero(size_t widx) const -> uint64_t
+{
+  return widx < m_buf.size() ? masked_word(widx) : 0;
+}
+
+void mkit::Bitmask::bitwise_and(const Bitmask& other)
+{
+  const auto n = std::min(m_buf.size(), other.m_num_bits / 64);  // Whole words of `other`
+  const uint64_t* src = other.m_buf.data();
+  uint64_t* dst = m_buf.data();
+#pragma omp parallel for simd if (n > parallel_threshold)
+  for (size_t i = 0; i < n; i++)
+    dst[i] &= src[i];
+  if (n < m_buf.size()) {
+    m_buf[n] &= other.word_or_zero(n);
+    std::fill(m_buf.begin() + n + 1, m_buf.end(), 0);
+  }
+}
+
+void mkit::Bitmask::bitwise_or(const Bitmask& other)
+{
+  const auto n = std::min(m_buf.size(), other.m_num_bits / 64);  // Whole words of `other`
+  const uint64_t* src = other.m_buf.data();
+  uint64_t* dst = m_buf.data();
+#pragma omp parallel for simd if (n > parallel_threshold)
+  for (size_t i = 0; i < n; i++)
+    dst[i] |= src[i];
+  if (n < m_buf.size())
+    m_buf[n] |= other.word_or_zero(n);
+}
+
+void mkit::Bitmask::bitwise_xor(const Bitmask& other)
+{
+  const auto n = std::min(m_buf.size(), other.m_num_bits / 64);  // Whole words of `other`
+  const uint64_t* src = other.m_buf.data();
+  uint64_t* dst = m_buf.data();
+#pragma omp parallel for simd if (n > parallel_threshold)
+  for (size_t i = 0; i < n; i++)
+    dst[i] ^= src[i];
+  if (n < m_buf.size())
+    m_buf[n] ^= other.word_or_zero(n);
+}
+
+// Bits beyond size() in the last word are flipped too. count(), operator==, etc. ignore
+//    them through masked_word(), but they are visible in view_buffer().
+void mkit::Bitmask::bitwise_not()
+{
+  const auto n = m_buf.size();
+  uint64_t* dst = m_buf.data();
+#pragma omp parallel for simd if (n > parallel_threshold)
+  for (size_t i = 0; i < n; i++)
+    dst[i] = ~dst[i];
+}
+
+auto mkit::Bitmask::count() const -> size_t
+{
+  if (m_buf.empty())
+    return 0;
+
+  // All but the last word
+  const auto n = m_buf.size() - 1;
+  const uint64_t* src = m_buf.data();
+  size_t total = 0;
+#pragma omp parallel for simd reduction(+ : total) if (n > parallel_threshold)
+  for (size_t i = 0; i < n; i++)
+    total += std::popcount(src[i]);
+
+  return total + std::popcount(masked_word(n));
+}
+
+auto mkit::Bitmask::count(size_t start, size_t end) const -> size_t
+{
+  end = std::min(end, m_num_bits);
+  if (start >= end)
+    return 0;
+
+  const auto first = start / 64, last = (end - 1) / 64;
+  const auto head = ~uint64_t{0} << (start % 64);
+  const auto tail = ~uint64_t{0} >> (63 - (end - 1) % 64);
+  if (first == last)
+    return std::popcount(m_buf[first] & head & tail);
+
+  size_t total = std::popcount(m_buf[first] & head) + std::popcount(m_buf[last] & tail);
+  const uint64_t* src = m_buf.data();
+#pragma omp parallel for simd reduction(+ : total) if (last - first > parallel_threshold)
+  for (size_t i = first + 1; i < last; i++)
+    total += std::popcount(src[i]);
+
+  return total;
+}
+
+auto mkit::Bitmask::find_next_set(size_t idx) const -> size_t
+{
+  if (idx >= m_num_bits)
+    return m_num_bits;
+
+  auto widx = idx / 64;
+  auto word = masked_word(widx) & (~uint64_t{0} << (idx % 64));
+  while (word == 0) {
+    if (++widx == m_buf.size())
+      return m_num_bits;
+    word = masked_word(widx);
+  }
+  return widx * 64 + std::countr_zero(word);
+}
+
+auto mkit::Bitmask::find_next_unset(size_t idx) const -> size_t
+{
+  if (idx >= m_num_bits)
+    return m_num_bits;
+
+  auto widx = idx / 64;
+  auto word = ~m_buf[widx] & (~uint64_t{0} << (idx % 64));
+  while (word == 0) {
+    if (++widx == m_buf.size())
+      return m_num_bits;
+    word = ~m_buf[widx];
+  }
+  return std::min(widx * 64 + std::countr_zero(word), m_num_bits);
+}
+
+auto mkit::Bitmask::operator==(const Bitmask& other) const -> bool
+{
+  if (m_num_bits != other.m_num_bits)
+    return false;
+  if (m_buf.empty())
+    return true;
+
+  const auto n = m_buf.size() - 1;
+  return std::equal(m_buf.cbegin(), m_buf.cbegin() + n, other.m_buf.cbegin()) &&
+         masked_word(n) == other.masked_word(n);
+}
+
+//
+// Iteration over set bits
+//
+mkit::Bitmask::SetBitIterator::SetBitIterator(const Bitmask* mask, size_t word_idx)
+    : m_mask(mask), m_word_idx(word_idx)
+{
+  if (m_word_idx < m_mask->m_buf.size()) {
+    m_word = m_mask->masked_word(m_word_idx);
+    skip_empty_words();
+  }
+}
+
+auto mkit::Bitmask::SetBitIterator::operator++() -> SetBitIterator&
+{
+  m_word &= m_word - 1;  // Clear the lowest set bit
+  skip_empty_words();
+  return *this;
+}
+
+void mkit::Bitmask::SetBitIterator::skip_empty_words()
+{
+  const auto num_words = m_mask->m_buf.size();
+  while (m_word == 0 && ++m_word_idx < num_words)
+    m_word = m_mask->masked_word(m_word_idx);
+  if (m_word_idx >= num_words)
+    m_word_idx = num_words;
+}
+
+auto mkit::Bitmask::set_bits() const -> SetBitRange
+{
+  return SetBitRange(this);
+}
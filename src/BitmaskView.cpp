@@ -0,0 +1,27 @@
+#include "BitmaskView.h"
+
+#include <cstring>
+
+mkit::BitmaskView::BitmaskView(const void* p, size_t nbits)
+    : m_ptr(static_cast<const uint8_t*>(p)), m_num_bits(nbits)
+{
+}
+
+auto mkit::BitmaskView::size() const -> size_t
+{
+  return m_num_bits;
+}
+
+auto mkit::BitmaskView::read_long(size_t idx) const -> uint64_t
+{
+  uint64_t word;
+  std::memcpy(&word, m_ptr + idx / 64 * sizeof(uint64_t), sizeof(word));
+  return word;
+}
+
+auto mkit::BitmaskView::read_bit(size_t idx) const -> bool
+{
+  auto word = read_long(idx);
+  word &= uint64_t{1} << (idx % 64);
+  return (word != 0);
+}
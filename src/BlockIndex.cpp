@@ -0,0 +1,195 @@
+#include "MURaMKit.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+// Index definition:
+// index_len (uint64_t) + dims (3 x uint64_t) + block dims (3 x uint32_t) + reserved (uint32_t) +
+//   for each block: min (double) + max (double) + mean (double) + num_zero (uint64_t)
+//
+constexpr size_t header_len = sizeof(uint64_t) * 4 + sizeof(uint32_t) * 4;
+constexpr size_t entry_len = sizeof(double) * 3 + sizeof(uint64_t);
+
+struct Header {
+  mkit::dims_type dims = {0, 0, 0};
+  mkit::dims_type block = {0, 0, 0};
+  mkit::dims_type num_blocks = {0, 0, 0};
+};
+
+auto read_header(const uint8_t* p) -> Header
+{
+  auto h = Header();
+  for (size_t i = 0; i < 3; i++) {
+    uint64_t d = 0;
+    uint32_t b = 0;
+    std::memcpy(&d, p + sizeof(uint64_t) * (i + 1), sizeof(d));
+    std::memcpy(&b, p + sizeof(uint64_t) * 4 + sizeof(uint32_t) * i, sizeof(b));
+    h.dims[i] = d;
+    h.block[i] = b;
+    h.num_blocks[i] = b ? (d + b - 1) / b : 0;
+  }
+  return h;
+}
+
+};  // namespace
+
+auto mkit::calc_block_index_len(dims_type dims, dims_type block) -> size_t
+{
+  size_t num_blocks = 1;
+  for (size_t i = 0; i < 3; i++)
+    num_blocks *= (dims[i] + block[i] - 1) / block[i];
+  return header_len + entry_len * num_blocks;
+}
+
+void mkit::init_block_stats(BlockStats* stats, size_t num_blocks)
+{
+  const auto inf = std::numeric_limits<double>::infinity();
+  std::fill(stats, stats + num_blocks, BlockStats{inf, -inf, 0.0, 0});
+}
+
+void mkit::write_block_index(dims_type dims, dims_type block, const BlockStats* sums, void* dst)
+{
+  uint8_t* const p = static_cast<uint8_t*>(dst);
+  const uint64_t index_len = calc_block_index_len(dims, block);
+  std::memcpy(p, &index_len, sizeof(index_len));
+  for (size_t i = 0; i < 3; i++) {
+    const auto d = uint64_t{dims[i]};
+    const auto b = uint32_t(block[i]);
+    std::memcpy(p + sizeof(uint64_t) * (i + 1), &d, sizeof(d));
+    std::memcpy(p + sizeof(uint64_t) * 4 + sizeof(uint32_t) * i, &b, sizeof(b));
+  }
+  std::memset(p + sizeof(uint64_t) * 4 + sizeof(uint32_t) * 3, 0, sizeof(uint32_t));
+
+  const auto h = read_header(p);
+  const size_t num_blocks = h.num_blocks[0] * h.num_blocks[1] * h.num_blocks[2];
+
+#pragma omp parallel for
+  for (size_t idx = 0; idx < num_blocks; idx++) {
+    const size_t bx = idx % h.num_blocks[0];
+    const size_t by = idx / h.num_blocks[0] % h.num_blocks[1];
+    const size_t bz = idx / h.num_blocks[0] / h.num_blocks[1];
+    const size_t count = std::min(block[0], dims[0] - bx * block[0]) *
+                         std::min(block[1], dims[1] - by * block[1]) *
+                         std::min(block[2], dims[2] - bz * block[2]);
+    auto s = sums[idx];
+    s.mean /= double(count);
+    uint8_t* entry = p + header_len + entry_len * idx;
+    std::memcpy(entry, &s.min, sizeof(double));
+    std::memcpy(entry + 8, &s.max, sizeof(double));
+    std::memcpy(entry + 16, &s.mean, sizeof(double));
+    std::memcpy(entry + 24, &s.num_zero, sizeof(uint64_t));
+  }
+}
+
+template <typename T>
+auto mkit::block_index(const T* buf, dims_type dims, dims_type block, void** index) -> int
+{
+  if (*index != nullptr)
+    return 1;
+  for (size_t i = 0; i < 3; i++) {
+    if (dims[i] == 0 || block[i] == 0 || block[i] > UINT32_MAX)
+      return 1;
+    block[i] = std::min(block[i], dims[i]);
+  }
+
+  const size_t nbx = (dims[0] + block[0] - 1) / block[0];
+  const size_t nby = (dims[1] + block[1] - 1) / block[1];
+  const size_t nbz = (dims[2] + block[2] - 1) / block[2];
+  auto stats = std::vector<BlockStats>(nbx * nby * nbz);
+  init_block_stats(stats.data(), stats.size());
+
+  // Every thread works on a slab of blocks, so no two threads update the same block.
+  //
+#pragma omp parallel for
+  for (size_t bz = 0; bz < nbz; bz++)
+    for (size_t z = bz * block[2]; z < std::min(dims[2], (bz + 1) * block[2]); z++)
+      for (size_t y = 0; y < dims[1]; y++) {
+        const T* row = buf + (z * dims[1] + y) * dims[0];
+        BlockStats* blk = stats.data() + (bz * nby + y / block[1]) * nbx;
+        for (size_t x = 0; x < dims[0]; x++)
+          blk[x / block[0]].add(double(row[x]));
+      }
+
+  void* dst = std::malloc(calc_block_index_len(dims, block));
+  write_block_index(dims, block, stats.data(), dst);
+  *index = dst;
+  return 0;
+}
+template auto mkit::block_index(const float*, dims_type, dims_type, void**) -> int;
+template auto mkit::block_index(const double*, dims_type, dims_type, void**) -> int;
+
+auto mkit::retrieve_block_index_len(const void* index) -> size_t
+{
+  uint64_t len = 0;
+  std::memcpy(&len, index, sizeof(len));
+  return len;
+}
+
+auto mkit::retrieve_num_blocks(const void* index) -> size_t
+{
+  const auto h = read_header(static_cast<const uint8_t*>(index));
+  return h.num_blocks[0] * h.num_blocks[1] * h.num_blocks[2];
+}
+
+auto mkit::retrieve_block_stats(const void* index, size_t idx, dims_type* begin, dims_type* end)
+    -> BlockStats
+{
+  const uint8_t* const p = static_cast<const uint8_t*>(index);
+  const auto h = read_header(p);
+  const dims_type coord = {idx % h.num_blocks[0], idx / h.num_blocks[0] % h.num_blocks[1],
+                           idx / h.num_blocks[0] / h.num_blocks[1]};
+  for (size_t i = 0; i < 3; i++) {
+    if (begin)
+      (*begin)[i] = coord[i] * h.block[i];
+    if (end)
+      (*end)[i] = std::min(h.dims[i], (coord[i] + 1) * h.block[i]);
+  }
+
+  auto s = BlockStats();
+  const uint8_t* entry = p + header_len + entry_len * idx;
+  std::memcpy(&s.min, entry, sizeof(double));
+  std::memcpy(&s.max, entry + 8, sizeof(double));
+  std::memcpy(&s.mean, entry + 16, sizeof(double));
+  std::memcpy(&s.num_zero, entry + 24, sizeof(uint64_t));
+  return s;
+}
+
+auto mkit::query_blocks(const void* index, double lo, double hi) -> std::vector<size_t>
+{
+  const size_t num_blocks = retrieve_num_blocks(index);
+  auto blocks = std::vector<size_t>();
+  for (size_t idx = 0; idx < num_blocks; idx++) {
+    const auto s = retrieve_block_stats(index, idx, nullptr, nullptr);
+    if (s.max >= lo && s.min <= hi)
+      blocks.push_back(idx);
+  }
+  return blocks;
+}
+
+auto mkit::locate_log_block_index(const void* meta) -> const void*
+{
+  const uint8_t* const p = static_cast<const uint8_t*>(meta);
+  auto [has_neg, has_zero, ternary, has_index, b4, b5, b6, b7] = unpack_8_booleans(p[8]);
+  if (!has_index)
+    return nullptr;
+
+  // The index is at the end of the meta data.
+  uint64_t buf_len = 0;
+  std::memcpy(&buf_len, p, sizeof(buf_len));
+  const auto index_len = calc_block_index_len({buf_len, 1, 1}, {log_block_len, 1, 1});
+  return p + retrieve_log_meta_len(meta) - index_len;
+}
+
+auto mkit::locate_slice_norm_block_index(const void* meta, dims_type dims) -> const void*
+{
+  const size_t pos = (dims[2] == 1) ? sizeof(uint32_t)
+                                    : sizeof(uint32_t) + sizeof(double) * 2 * dims[0];
+  if (retrieve_slice_norm_meta_len(meta) <= pos)
+    return nullptr;
+  else
+    return static_cast<const uint8_t*>(meta) + pos;
+}
@@ -0,0 +1,266 @@
+#include "Container.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace {
+
+constexpr char magic[8] = {'M', 'U', 'R', 'a', 'M', 'K', 'i', 't'};
+constexpr uint32_t version = 1;
+constexpr size_t header_len = 64;
+constexpr uint64_t alignment = 4096;
+
+template <typename T>
+void append(std::vector<uint8_t>& buf, T val)
+{
+  const auto* p = reinterpret_cast<const uint8_t*>(&val);
+  buf.insert(buf.end(), p, p + sizeof(T));
+}
+
+// Reads a value at `pos` of `buf` and advances `pos`. Returns false if out of range.
+template <typename T>
+auto extract(const uint8_t* buf, size_t buf_len, size_t& pos, T& val) -> bool
+{
+  if (pos + sizeof(T) > buf_len)
+    return false;
+  std::memcpy(&val, buf + pos, sizeof(T));
+  pos += sizeof(T);
+  return true;
+}
+
+};  // namespace
+
+//
+// ContainerWriter
+//
+mkit::ContainerWriter::~ContainerWriter()
+{
+  if (m_file)
+    finish();
+}
+
+auto mkit::ContainerWriter::open(const std::string& filename) -> int
+{
+  if (m_file)
+    return 1;
+  m_file = std::fopen(filename.c_str(), "wb");
+  if (!m_file)
+    return 1;
+
+  // Reserve space for the header, which is written at the end.
+  const auto zeros = std::array<uint8_t, header_len>{};
+  if (std::fwrite(zeros.data(), 1, header_len, m_file) != header_len)
+    return 1;
+  m_pos = header_len;
+  m_entries.clear();
+
+  return 0;
+}
+
+auto mkit::ContainerWriter::add_field(const std::string& name,
+                                      bool is_float,
+                                      dims_type dims,
+                                      const std::vector<Op>& ops,
+                                      const void* payload,
+                                      size_t payload_len,
+                                      const void* meta,
+                                      size_t meta_len) -> int
+{
+  if (!m_file || name.empty() || name.size() > UINT16_MAX || ops.size() > UINT8_MAX)
+    return 1;
+  if (std::any_of(m_entries.cbegin(), m_entries.cend(),
+                  [&name](const auto& e) { return e.info.name == name; }))
+    return 1;
+
+  // Pad to the next aligned position.
+  const auto zeros = std::vector<uint8_t>(alignment - m_pos % alignment, 0);
+  if (zeros.size() < alignment) {
+    if (std::fwrite(zeros.data(), 1, zeros.size(), m_file) != zeros.size())
+      return 1;
+    m_pos += zeros.size();
+  }
+
+  auto entry = Entry();
+  entry.info.name = name;
+  entry.info.is_float = is_float;
+  entry.info.dims = dims;
+  entry.info.ops = ops;
+  entry.info.payload_len = payload_len;
+  entry.info.meta_len = meta_len;
+  entry.payload_offset = m_pos;
+  entry.meta_offset = m_pos + payload_len;
+
+  if (std::fwrite(payload, 1, payload_len, m_file) != payload_len)
+    return 1;
+  if (meta_len && std::fwrite(meta, 1, meta_len, m_file) != meta_len)
+    return 1;
+  m_pos += payload_len + meta_len;
+
+  m_entries.push_back(std::move(entry));
+
+  return 0;
+}
+
+auto mkit::ContainerWriter::finish() -> int
+{
+  if (!m_file)
+    return 1;
+
+  // Serialize the field table.
+  auto table = std::vector<uint8_t>();
+  for (const auto& e : m_entries) {
+    append(table, uint16_t(e.info.name.size()));
+    table.insert(table.end(), e.info.name.begin(), e.info.name.end());
+    append(table, uint8_t(e.info.is_float));
+    append(table, uint8_t(e.info.ops.size()));
+    for (auto op : e.info.ops)
+      append(table, uint8_t(op));
+    for (auto d : e.info.dims)
+      append(table, uint64_t(d));
+    append(table, e.payload_offset);
+    append(table, uint64_t(e.info.payload_len));
+    append(table, e.meta_offset);
+    append(table, uint64_t(e.info.meta_len));
+  }
+
+  // Assemble the header.
+  auto header = std::vector<uint8_t>(magic, magic + sizeof(magic));
+  append(header, version);
+  append(header, uint32_t(m_entries.size()));
+  append(header, m_pos);
+  append(header, uint64_t(table.size()));
+  header.resize(header_len, 0);
+
+  auto rtn = 0;
+  if (std::fwrite(table.data(), 1, table.size(), m_file) != table.size())
+    rtn = 1;
+  if (rtn == 0 && std::fseek(m_file, 0, SEEK_SET) != 0)
+    rtn = 1;
+  if (rtn == 0 && std::fwrite(header.data(), 1, header.size(), m_file) != header.size())
+    rtn = 1;
+  if (std::fclose(m_file) != 0)
+    rtn = 1;
+
+  m_file = nullptr;
+  m_entries.clear();
+
+  return rtn;
+}
+
+//
+// ContainerReader
+//
+mkit::ContainerReader::~ContainerReader()
+{
+  close();
+}
+
+auto mkit::ContainerReader::open(const std::string& filename) -> int
+{
+  close();
+
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    return 1;
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || size_t(st.st_size) < header_len) {
+    ::close(fd);
+    return 1;
+  }
+  m_len = st.st_size;
+  void* addr = ::mmap(nullptr, m_len, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    m_len = 0;
+    return 1;
+  }
+  m_addr = addr;
+
+  // Parse the header.
+  const auto* p = static_cast<const uint8_t*>(m_addr);
+  uint32_t ver = 0, num_fields = 0;
+  uint64_t table_offset = 0, table_len = 0;
+  size_t pos = sizeof(magic);
+  extract(p, m_len, pos, ver);
+  extract(p, m_len, pos, num_fields);
+  extract(p, m_len, pos, table_offset);
+  extract(p, m_len, pos, table_len);
+  if (std::memcmp(p, magic, sizeof(magic)) != 0 || ver != version ||
+      table_offset + table_len > m_len) {
+    close();
+    return 1;
+  }
+
+  // Parse the field table.
+  const auto* table = p + table_offset;
+  pos = 0;
+  for (uint32_t f = 0; f < num_fields; f++) {
+    auto info = FieldInfo();
+    uint16_t name_len = 0;
+    uint8_t is_float = 0, num_ops = 0;
+    bool good = extract(table, table_len, pos, name_len) && pos + name_len <= table_len;
+    if (good) {
+      info.name.assign(reinterpret_cast<const char*>(table + pos), name_len);
+      pos += name_len;
+      good = extract(table, table_len, pos, is_float) && extract(table, table_len, pos, num_ops);
+    }
+    for (uint8_t i = 0; good && i < num_ops; i++) {
+      uint8_t op = 0;
+      good = extract(table, table_len, pos, op);
+      info.ops.push_back(Op{op});
+    }
+    uint64_t val[7] = {};
+    for (size_t i = 0; good && i < 7; i++)
+      good = extract(table, table_len, pos, val[i]);
+    if (!good || val[3] + val[4] > m_len || val[5] + val[6] > m_len) {
+      close();
+      return 1;
+    }
+
+    info.is_float = is_float;
+    info.dims = {val[0], val[1], val[2]};
+    info.payload = p + val[3];
+    info.payload_len = val[4];
+    info.meta = val[6] ? p + val[5] : nullptr;
+    info.meta_len = val[6];
+    m_lookup.emplace(info.name, m_fields.size());
+    m_fields.push_back(std::move(info));
+  }
+
+  return 0;
+}
+
+void mkit::ContainerReader::close()
+{
+  if (m_addr)
+    ::munmap(m_addr, m_len);
+  m_addr = nullptr;
+  m_len = 0;
+  m_fields.clear();
+  m_lookup.clear();
+}
+
+auto mkit::ContainerReader::num_fields() const -> size_t
+{
+  return m_fields.size();
+}
+
+auto mkit::ContainerReader::field(size_t idx) const -> const FieldInfo&
+{
+  return m_fields[idx];
+}
+
+auto mkit::ContainerReader::find(const std::string& name) const -> const FieldInfo*
+{
+  auto it = m_lookup.find(name);
+  if (it == m_lookup.end())
+    return nullptr;
+  else
+    return &m_fields[it->second];
+}
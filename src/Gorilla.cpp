@@ -0,0 +1,256 @@
+#include "MURaMKit.h"
+#include <omp.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+// Stream definition:
+// for each block: byte offset of its end, relative to the first block (uint64_t) +
+//   for each block: its bits, padded to a multiple of 64 bits
+//
+// Every block holds `block_len` values (fewer for the last one), and is encoded
+//    independently from others, so blocks can be encoded and decoded in parallel.
+//    Within a block, the first value is kept verbatim, and every other value is XOR'ed
+//    with its predecessor and coded as follows:
+//    - '0' if the XOR is zero;
+//    - '10' + its meaningful bits, if they fit in the window of the previous XOR;
+//    - '11' + number of leading zeros + number of meaningful bits minus 1 + meaningful bits.
+//
+constexpr size_t block_len = 4096;
+
+// Appends bits to a buffer of 64-bit words, starting from the least significant bit.
+class BitWriter {
+ public:
+  void put(uint64_t bits, int n)  // `bits` must not have anything above the lowest n bits.
+  {
+    if (n == 0)
+      return;
+    m_acc |= bits << m_fill;
+    if (m_fill + n >= 64) {
+      m_words.push_back(m_acc);
+      m_acc = (m_fill == 0) ? 0 : bits >> (64 - m_fill);
+      m_fill = m_fill + n - 64;
+    }
+    else
+      m_fill += n;
+  }
+
+  auto finish() -> std::vector<uint64_t>&
+  {
+    if (m_fill > 0)
+      m_words.push_back(m_acc);
+    m_acc = 0;
+    m_fill = 0;
+    return m_words;
+  }
+
+ private:
+  std::vector<uint64_t> m_words;
+  uint64_t m_acc = 0;
+  int m_fill = 0;
+};
+
+// Reads bits written by BitWriter.
+class BitReader {
+ public:
+  explicit BitReader(const uint8_t* p) : m_ptr(p) {}
+
+  auto get(int n) -> uint64_t
+  {
+    if (n == 0)
+      return 0;
+    uint64_t bits = load(m_word) >> m_pos;
+    if (m_pos + n > 64)
+      bits |= load(m_word + 1) << (64 - m_pos);
+    if (n < 64)
+      bits &= (uint64_t{1} << n) - 1;
+    m_pos += n;
+    if (m_pos >= 64) {
+      m_word++;
+      m_pos -= 64;
+    }
+    return bits;
+  }
+
+ private:
+  const uint8_t* m_ptr = nullptr;
+  size_t m_word = 0;
+  int m_pos = 0;
+
+  auto load(size_t w) const -> uint64_t
+  {
+    uint64_t v;
+    std::memcpy(&v, m_ptr + w * 8, 8);
+    return v;
+  }
+};
+
+template <size_t W>
+void encode_block(const uint8_t* in, size_t len, BitWriter& writer)
+{
+  using word_t = std::conditional_t<W == 4, uint32_t, uint64_t>;
+  constexpr int nbits = W * 8;
+  constexpr int field_bits = (W == 4) ? 5 : 6;  // Bits to record a count in [0, nbits).
+
+  word_t prev = 0;
+  std::memcpy(&prev, in, W);
+  writer.put(prev, nbits);
+
+  int prev_lead = nbits, prev_trail = 0;  // The window of the previous XOR; empty at first.
+  for (size_t i = 1; i < len; i++) {
+    word_t v;
+    std::memcpy(&v, in + i * W, W);
+    const word_t x = v ^ prev;
+    prev = v;
+    if (x == 0) {
+      writer.put(0, 1);
+      continue;
+    }
+
+    const int lead = std::countl_zero(x);
+    const int trail = std::countr_zero(x);
+    if (lead >= prev_lead && trail >= prev_trail) {
+      writer.put(0b01, 2);  // '1' then '0'
+      writer.put(x >> prev_trail, nbits - prev_lead - prev_trail);
+    }
+    else {
+      const int meaningful = nbits - lead - trail;
+      writer.put(0b11, 2);
+      writer.put(uint64_t(lead), field_bits);
+      writer.put(uint64_t(meaningful - 1), field_bits);
+      writer.put(x >> trail, meaningful);
+      prev_lead = lead;
+      prev_trail = trail;
+    }
+  }
+}
+
+template <size_t W>
+void decode_block(const uint8_t* in, size_t len, uint8_t* out)
+{
+  using word_t = std::conditional_t<W == 4, uint32_t, uint64_t>;
+  constexpr int nbits = W * 8;
+  constexpr int field_bits = (W == 4) ? 5 : 6;
+
+  auto reader = BitReader(in);
+  word_t prev = word_t(reader.get(nbits));
+  std::memcpy(out, &prev, W);
+
+  int prev_lead = nbits, prev_trail = 0;
+  for (size_t i = 1; i < len; i++) {
+    if (reader.get(1)) {
+      if (reader.get(1)) {
+        prev_lead = int(reader.get(field_bits));
+        const int meaningful = int(reader.get(field_bits)) + 1;
+        prev_trail = nbits - prev_lead - meaningful;
+      }
+      prev ^= word_t(reader.get(nbits - prev_lead - prev_trail) << prev_trail);
+    }
+    std::memcpy(out + i * W, &prev, W);
+  }
+}
+
+template <size_t W>
+auto encode(const uint8_t* in, size_t len) -> std::vector<uint8_t>
+{
+  const size_t num_blocks = (len + block_len - 1) / block_len;
+  auto blocks = std::vector<std::vector<uint64_t>>(num_blocks);
+
+#pragma omp parallel for
+  for (size_t blk = 0; blk < num_blocks; blk++) {
+    const size_t begin = blk * block_len;
+    auto writer = BitWriter();
+    encode_block<W>(in + begin * W, std::min(block_len, len - begin), writer);
+    blocks[blk] = std::move(writer.finish());
+  }
+
+  // Lay out the directory, and then copy all blocks to their places.
+  const size_t dir_len = sizeof(uint64_t) * num_blocks;
+  auto ends = std::vector<uint64_t>(num_blocks);
+  uint64_t end = 0;
+  for (size_t blk = 0; blk < num_blocks; blk++) {
+    end += blocks[blk].size() * sizeof(uint64_t);
+    ends[blk] = end;
+  }
+  auto stream = std::vector<uint8_t>(dir_len + end);
+  std::memcpy(stream.data(), ends.data(), dir_len);
+
+#pragma omp parallel for
+  for (size_t blk = 0; blk < num_blocks; blk++) {
+    const uint64_t begin = (blk == 0) ? 0 : ends[blk - 1];
+    std::memcpy(stream.data() + dir_len + begin, blocks[blk].data(),
+                blocks[blk].size() * sizeof(uint64_t));
+  }
+
+  return stream;
+}
+
+template <size_t W>
+void decode(const uint8_t* in, size_t len, uint8_t* out)
+{
+  const size_t num_blocks = (len + block_len - 1) / block_len;
+  const uint8_t* payload = in + sizeof(uint64_t) * num_blocks;
+
+#pragma omp parallel for
+  for (size_t blk = 0; blk < num_blocks; blk++) {
+    uint64_t begin = 0;
+    if (blk > 0)
+      std::memcpy(&begin, in + sizeof(uint64_t) * (blk - 1), sizeof(begin));
+    const size_t first = blk * block_len;
+    decode_block<W>(payload + begin, std::min(block_len, len - first), out + first * W);
+  }
+}
+
+};  // namespace
+
+auto mkit::gorilla_encode(const void* input, size_t num_vals, size_t width)
+    -> std::vector<uint8_t>
+{
+  const auto* in = static_cast<const uint8_t*>(input);
+  if (width == 4)
+    return encode<4>(in, num_vals);
+  else
+    return encode<8>(in, num_vals);
+}
+
+void mkit::gorilla_decode(const void* input, size_t num_vals, size_t width, void* output)
+{
+  const auto* in = static_cast<const uint8_t*>(input);
+  auto* out = static_cast<uint8_t*>(output);
+  if (width == 4)
+    decode<4>(in, num_vals, out);
+  else
+    decode<8>(in, num_vals, out);
+}
+
+auto mkit::retrieve_gorilla_len(const void* input, size_t num_vals) -> size_t
+{
+  const size_t num_blocks = (num_vals + block_len - 1) / block_len;
+  if (num_blocks == 0)
+    return 0;
+  uint64_t end = 0;
+  std::memcpy(&end, static_cast<const uint8_t*>(input) + sizeof(uint64_t) * (num_blocks - 1),
+              sizeof(end));
+  return sizeof(uint64_t) * num_blocks + end;
+}
+
+auto mkit::calc_gorilla_max_len(size_t num_vals, size_t width) -> size_t
+{
+  // In the worst case, every value but the first of a block takes a control code, two
+  //    counts, and all of its bits.
+  const size_t nbits = width * 8;
+  const size_t field_bits = (width == 4) ? 5 : 6;
+  const size_t num_blocks = (num_vals + block_len - 1) / block_len;
+  size_t len = sizeof(uint64_t) * num_blocks;
+  for (size_t blk = 0; blk < num_blocks; blk++) {
+    const size_t n = std::min(block_len, num_vals - blk * block_len);
+    const size_t bits = nbits + (n - 1) * (2 + field_bits * 2 + nbits);
+    len += (bits + 63) / 64 * sizeof(uint64_t);
+  }
+  return len;
+}
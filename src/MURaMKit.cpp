@@ -1,33 +1,413 @@
 #include "MURaMKit.h"
 #include <omp.h>
 #include "Bitmask.h"
+#include "BitmaskView.h"
+#include "Reduction.h"
+#include "Sketch.h"
+#include "Tune.h"
 
 #include <algorithm>
+#include <bit>
 #include <cassert>
 #include <cmath>
 #include <cstring>
+#include <functional>
+#include <limits>
 #include <memory>
 #include <numeric>
+#include <type_traits>
+#include <unordered_map>
+
+namespace {
+
+// Layout of the outputs of bitmask_zero() and bitmask_value():
+// precision and options (1 byte) + input_num_vals (8 byte) + other_num_vals (8 byte) +
+//   with BZ_VALUE_LIST: num_fills (1 byte) + fill values +
+//   mask, with set bits at masked values (padded to 64-bit words), or with BZ_ADAPTIVE,
+//     the mask coded by adaptive_mask_encode() +
+//   with more than one fill value: selectors, 2 bits per masked value (padded to 64-bit words) +
+//   other values, verbatim, shuffled, or XOR-coded.
+//
+// Values that are neither masked as zeros by bitmask_zero(), nor masked as fill values by
+//    bitmask_value(), are called "other values" below.
+//
+constexpr size_t bz_header_len = 17;
+
+auto bz_mask_pos(size_t width, size_t num_fills, uint8_t options) -> size_t
+{
+  return bz_header_len + ((options & mkit::BZ_VALUE_LIST) ? 1 + num_fills * width : 0);
+}
+
+// Number of bytes up to the other values, given the number of bytes of the mask.
+auto bz_prefix_len(size_t num_vals,
+                   size_t num_others,
+                   size_t width,
+                   size_t num_fills,
+                   uint8_t options,
+                   size_t mask_len) -> size_t
+{
+  auto len = bz_mask_pos(width, num_fills, options) + mask_len;
+  if ((options & mkit::BZ_VALUE_LIST) && num_fills > 1)
+    len += ((num_vals - num_others) * 2 + 63) / 64 * 8;
+  return len;
+}
+
+// Number of bytes of the other values when they are not XOR-coded.
+auto bz_stream_len(size_t num_others, size_t width, uint8_t options) -> size_t
+{
+  if (options & mkit::BZ_SHUFFLE_ALL)
+    return mkit::calc_shuffle_len(num_others, width, (options & mkit::BZ_SHUFFLE_ALL) >> 2);
+  else
+    return num_others * width;
+}
+
+// Split values into masked ones, marked by set bits of `mask_words`, and others, which are
+//    gathered in `others` in their order. `match(v)` returns the index of the fill value that
+//    `v` matches, or -1, and the indices of masked values are kept in `selectors` if it is
+//    not nullptr. Chunks are classified in parallel first, and then their other values are
+//    moved to offsets found by a prefix sum of their counts, also in parallel. Bits beyond
+//    `len` in the last word are set.
+template <typename T, typename Match>
+void split_values(const T* input,
+                  size_t len,
+                  Match match,
+                  std::vector<uint64_t>& mask_words,
+                  std::vector<T>& others,
+                  std::vector<uint8_t>* selectors)
+{
+  const size_t chunk_words = 256;
+  const size_t num_words = (len + 63) / 64;
+  const size_t num_chunks = (num_words + chunk_words - 1) / chunk_words;
+  auto offsets = std::vector<size_t>(num_chunks + 1, 0);
+  mask_words.assign(num_words, 0);
+
+#pragma omp parallel for
+  for (size_t c = 0; c < num_chunks; c++) {
+    const size_t end = std::min(num_words, (c + 1) * chunk_words);
+    size_t cnt = 0;
+    for (size_t w = c * chunk_words; w < end; w++) {
+      const size_t n = std::min<size_t>(64, len - w * 64);
+      const T* vals = input + w * 64;
+      uint64_t bits = 0;
+      for (size_t k = 0; k < n; k++)
+        bits |= uint64_t(match(vals[k]) >= 0) << k;
+      cnt += n - std::popcount(bits);
+      if (n < 64)
+        bits |= ~uint64_t{0} << n;
+      mask_words[w] = bits;
+    }
+    offsets[c + 1] = cnt;
+  }
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+  others.resize(offsets.back());
+  if (selectors)
+    selectors->resize(len - offsets.back());
+
+#pragma omp parallel for
+  for (size_t c = 0; c < num_chunks; c++) {
+    const size_t end = std::min(num_words, (c + 1) * chunk_words);
+    auto counter = offsets[c];
+    auto masked_counter = c * chunk_words * 64 - offsets[c];
+    for (size_t w = c * chunk_words; w < end; w++) {
+      const size_t n = std::min<size_t>(64, len - w * 64);
+      const uint64_t valid = (n < 64) ? (uint64_t{1} << n) - 1 : ~uint64_t{0};
+      for (auto word = ~mask_words[w] & valid; word; word &= word - 1)
+        others[counter++] = input[w * 64 + std::countr_zero(word)];
+      if (selectors) {
+        for (auto word = mask_words[w] & valid; word; word &= word - 1)
+          (*selectors)[masked_counter++] = uint8_t(match(input[w * 64 + std::countr_zero(word)]));
+      }
+    }
+  }
+}
+
+// Place values from a stream of other values (which does not need to be aligned) to
+//    positions indicated by unset bits of a mask, and fill the other positions with the fill
+//    value given by their selectors (or zeros, when there is no fill value).
+//    The work is split into chunks, whose offsets in the stream are found by counting unset
+//    bits, so that all chunks can proceed in parallel.
+template <typename T>
+void scatter_others(const mkit::BitmaskView& mask,
+                    const uint8_t* src,
+                    size_t len,
+                    const T* fills,
+                    size_t num_fills,
+                    const uint8_t* selectors,
+                    T* dst)
+{
+  const size_t chunk_words = 256;
+  const size_t num_words = (len + 63) / 64;
+  const size_t num_chunks = (num_words + chunk_words - 1) / chunk_words;
+  auto offsets = std::vector<size_t>(num_chunks + 1, 0);
+
+#pragma omp parallel for
+  for (size_t c = 0; c < num_chunks; c++) {
+    const size_t end = std::min(num_words, (c + 1) * chunk_words);
+    size_t cnt = 0;
+    for (size_t w = c * chunk_words; w < end; w++) {
+      auto word = ~mask.read_long(w * 64);
+      if (w == num_words - 1 && len % 64 != 0)
+        word &= (uint64_t{1} << (len % 64)) - 1;
+      cnt += std::popcount(word);
+    }
+    offsets[c + 1] = cnt;
+  }
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+  auto selector = [selectors](size_t k) -> size_t {
+    uint64_t word = 0;
+    std::memcpy(&word, selectors + k / 32 * 8, sizeof(word));
+    return (word >> (k % 32 * 2)) & 3;
+  };
+
+#pragma omp parallel for
+  for (size_t c = 0; c < num_chunks; c++) {
+    const size_t end = std::min(num_words, (c + 1) * chunk_words);
+    std::fill(dst + c * chunk_words * 64, dst + std::min(len, end * 64),
+              num_fills ? fills[0] : T{0});
+    auto counter = offsets[c];
+    auto masked_counter = c * chunk_words * 64 - offsets[c];
+    for (size_t w = c * chunk_words; w < end; w++) {
+      auto word = ~mask.read_long(w * 64);
+      if (w == num_words - 1 && len % 64 != 0)
+        word &= (uint64_t{1} << (len % 64)) - 1;
+      if (num_fills > 1) {
+        auto masked = ~word;
+        if (w == num_words - 1 && len % 64 != 0)
+          masked &= (uint64_t{1} << (len % 64)) - 1;
+        for (; masked; masked &= masked - 1)
+          dst[w * 64 + std::countr_zero(masked)] = fills[selector(masked_counter++)];
+      }
+      while (word) {
+        const size_t i = w * 64 + std::countr_zero(word);
+        std::memcpy(dst + i, src + counter * sizeof(T), sizeof(T));
+        counter++;
+        word &= word - 1;
+      }
+    }
+  }
+}
+
+// Find up to `max_fills` values that are repeated the most in runs of bitwise equal
+//    neighbors, which is what constant regions are made of. Every task counts the runs
+//    within its chunk, so a run across two chunks is counted as two runs.
+template <typename T>
+auto dominant_values(const T* input, size_t len, size_t max_fills) -> std::vector<T>
+{
+  using uint_type = std::conditional_t<std::is_same_v<T, float>, uint32_t, uint64_t>;
+  const size_t chunk = 16384;
+  const size_t num_chunks = (len + chunk - 1) / chunk;
+  auto counts = std::unordered_map<uint_type, size_t>();
+
+#pragma omp parallel
+  {
+    auto local = std::unordered_map<uint_type, size_t>();
+#pragma omp for
+    for (size_t c = 0; c < num_chunks; c++) {
+      const size_t end = std::min(len, (c + 1) * chunk);
+      for (size_t i = c * chunk; i < end;) {
+        const auto bits = std::bit_cast<uint_type>(input[i]);
+        size_t j = i + 1;
+        while (j < end && std::bit_cast<uint_type>(input[j]) == bits)
+          j++;
+        if (j - i > 1)
+          local[bits] += j - i;
+        i = j;
+      }
+    }
+#pragma omp critical
+    for (const auto& [bits, cnt] : local)
+      counts[bits] += cnt;
+  }
+
+  auto ranked = std::vector<std::pair<size_t, uint_type>>();
+  for (const auto& [bits, cnt] : counts)
+    ranked.emplace_back(cnt, bits);
+  const size_t num = std::min(max_fills, ranked.size());
+  std::partial_sort(ranked.begin(), ranked.begin() + num, ranked.end(), std::greater<>());
+  auto fills = std::vector<T>(num);
+  for (size_t k = 0; k < num; k++)
+    fills[k] = std::bit_cast<T>(ranked[k].second);
+  return fills;
+}
+
+// Encode the output of bitmask_zero() or bitmask_value(). Fill values are only recorded
+//    with BZ_VALUE_LIST.
+template <typename T, typename Match>
+auto encode_bitmask(const T* input,
+                    size_t len,
+                    Match match,
+                    const std::vector<T>& fills,
+                    uint8_t options,
+                    void** output) -> int
+{
+  const bool value_list = options & mkit::BZ_VALUE_LIST;
+  auto mask_words = std::vector<uint64_t>();
+  auto others = std::vector<T>();
+  auto selectors = std::vector<uint8_t>();
+  const bool with_selectors = value_list && fills.size() > 1;
+  split_values(input, len, match, mask_words, others, with_selectors ? &selectors : nullptr);
+
+  const size_t width = sizeof(T);
+  const size_t num_others = others.size();
+  const uint8_t shuffle_flags = (options & mkit::BZ_SHUFFLE_ALL) >> 2;
+  auto coded_mask = std::vector<uint8_t>();
+  if (options & mkit::BZ_ADAPTIVE)
+    coded_mask = mkit::adaptive_mask_encode(mask_words.data(), len);
+  const size_t mask_len = (options & mkit::BZ_ADAPTIVE) ? coded_mask.size()
+                                                        : mask_words.size() * sizeof(uint64_t);
+  const auto prefix_len = bz_prefix_len(len, num_others, width, fills.size(), options, mask_len);
+  auto coded = std::vector<uint8_t>();
+  if (options & mkit::BZ_GORILLA)
+    coded = mkit::gorilla_encode(others.data(), num_others, width);
+  const size_t total_len = prefix_len + ((options & mkit::BZ_GORILLA)
+                                             ? coded.size()
+                                             : bz_stream_len(num_others, width, options));
+
+  uint8_t* buf = static_cast<uint8_t*>(std::malloc(total_len));
+  buf[0] = std::is_same_v<T, float> | options;           // Save precision and options
+  std::memcpy(&buf[1], &len, sizeof(len));               // Save input_num_vals
+  std::memcpy(&buf[9], &num_others, sizeof(num_others));  // Save other_num_vals
+  size_t pos = bz_header_len;
+  if (value_list) {  // Save fill values
+    buf[pos++] = uint8_t(fills.size());
+    std::memcpy(&buf[pos], fills.data(), fills.size() * width);
+    pos += fills.size() * width;
+  }
+  if (options & mkit::BZ_ADAPTIVE)  // Save the mask
+    std::memcpy(&buf[pos], coded_mask.data(), mask_len);
+  else
+    std::memcpy(&buf[pos], mask_words.data(), mask_len);
+  pos += mask_len;
+  if (with_selectors) {  // Pack selectors, 32 in a word
+    const size_t num_sel_words = (selectors.size() * 2 + 63) / 64;
+#pragma omp parallel for
+    for (size_t w = 0; w < num_sel_words; w++) {
+      uint64_t word = 0;
+      const size_t end = std::min(selectors.size(), w * 32 + 32);
+      for (size_t k = w * 32; k < end; k++)
+        word |= uint64_t(selectors[k]) << (k % 32 * 2);
+      std::memcpy(&buf[pos + w * 8], &word, sizeof(word));
+    }
+    pos += num_sel_words * 8;
+  }
+  if (options & mkit::BZ_SHUFFLE_ALL)  // Save other values
+    mkit::shuffle_bytes(others.data(), num_others, width, shuffle_flags, &buf[pos]);
+  else if (options & mkit::BZ_GORILLA)
+    std::memcpy(&buf[pos], coded.data(), coded.size());
+  else
+    std::memcpy(&buf[pos], others.data(), num_others * width);
+
+  *output = buf;
+  return 0;
+}
+
+// Base-2 mode of smart_log(): the bits of |v|, read as an integer, scaled by 2^-M (M being
+//    the number of mantissa bits) and minus the exponent bias, equal e + f for
+//    |v| = 2^e * (1 + f). This is a monotone, piecewise-linear approximation of log2(|v|),
+//    which continues linearly through subnormals down to zero. The inverse rounds back to
+//    the nearest bit pattern, so it is exact whenever the transformed value keeps all bits.
+template <typename T>
+auto bits_log2(T v) -> double
+{
+  using uint_type = std::conditional_t<std::is_same_v<T, float>, uint32_t, uint64_t>;
+  constexpr double scale = 1.0 / double(uint64_t{1} << (std::numeric_limits<T>::digits - 1));
+  constexpr double bias = std::numeric_limits<T>::max_exponent - 1;
+  const auto bits = std::bit_cast<uint_type>(v) & (~uint_type{0} >> 1);
+  return double(bits) * scale - bias;
+}
+
+template <typename T>
+auto bits_exp2(double v) -> T
+{
+  using uint_type = std::conditional_t<std::is_same_v<T, float>, uint32_t, uint64_t>;
+  constexpr double scale = double(uint64_t{1} << (std::numeric_limits<T>::digits - 1));
+  constexpr double bias = std::numeric_limits<T>::max_exponent - 1;
+  constexpr auto max_bits = ~uint_type{0} >> 1;
+  const double scaled = (v + bias) * scale + 0.5;
+  if (!(scaled >= 1.0))  // Also catches NaN
+    return T{0};
+  if (scaled >= double(max_bits))
+    return std::bit_cast<T>(max_bits);
+  return std::bit_cast<T>(uint_type(scaled));
+}
+
+};  // namespace
 
 template <typename T>
 auto mkit::smart_log(T* buf, size_t buf_len, void** meta) -> int
 {
-  if (*meta != nullptr)
+  return smart_log(static_cast<const T*>(buf), buf, buf_len, meta);
+}
+template auto mkit::smart_log(float* buf, size_t buf_len, void** meta) -> int;
+template auto mkit::smart_log(double* buf, size_t buf_len, void** meta) -> int;
+
+template <typename T1, typename T2>
+auto mkit::smart_log(const T1* input, T2* output, size_t buf_len, void** meta) -> int
+{
+  return smart_log(input, output, buf_len, meta, 0);
+}
+template auto mkit::smart_log(const float*, float*, size_t, void**) -> int;
+template auto mkit::smart_log(const float*, double*, size_t, void**) -> int;
+template auto mkit::smart_log(const double*, float*, size_t, void**) -> int;
+template auto mkit::smart_log(const double*, double*, size_t, void**) -> int;
+
+template <typename T1, typename T2>
+auto mkit::smart_log(const T1* input, T2* output, size_t buf_len, void** meta, uint8_t options)
+    -> int
+{
+  return smart_log(input, output, buf_len, meta, options, nullptr, nullptr);
+}
+template auto mkit::smart_log(const float*, float*, size_t, void**, uint8_t) -> int;
+template auto mkit::smart_log(const float*, double*, size_t, void**, uint8_t) -> int;
+template auto mkit::smart_log(const double*, float*, size_t, void**, uint8_t) -> int;
+template auto mkit::smart_log(const double*, double*, size_t, void**, uint8_t) -> int;
+
+template <typename T1, typename T2>
+auto mkit::smart_log(const T1* input,
+                     T2* output,
+                     size_t buf_len,
+                     void** meta,
+                     uint8_t options,
+                     Sketch* in_sketch,
+                     Sketch* out_sketch) -> int
+{
+  if (*meta != nullptr || (options & ~(LOG_BLOCK_INDEX | LOG_BASE2)))
     return 1;
 
-  // Step 1: are there negative values and/or absolute zeros in `buf`?
+  // The base-2 mode is only exactly invertible when the output keeps all bits of e + f.
+  if ((options & LOG_BASE2) && sizeof(T2) <= sizeof(T1))
+    return 1;
+
+  // Arithmetic is carried out in the wider one of the two types.
+  using calc_type = std::common_type_t<T1, T2>;
+
+  // Step 1: are there negative values and/or absolute zeros in `input`?
+  //    In the base-2 mode, zeros need no record as they map to the lowest value, and
+  //    signs are recorded by their sign bits so that -0.0 survives the round trip too.
+  const bool base2 = options & LOG_BASE2;
   auto has_neg = false, has_zero = false;
 
 #pragma omp parallel
   {
-    if (omp_get_thread_num() == 0)  // The 1st thread
-      has_neg = std::any_of(buf, buf + buf_len, [](auto v) { return v < 0.0; });
-    if (omp_get_thread_num() == omp_get_max_threads() - 1)  // The last thread
-      has_zero = std::any_of(buf, buf + buf_len, [](auto v) { return v == 0.0; });
+    if (omp_get_thread_num() == 0) {  // The 1st thread
+      if (base2)
+        has_neg = std::any_of(input, input + buf_len, [](auto v) { return std::signbit(v); });
+      else
+        has_neg = std::any_of(input, input + buf_len, [](auto v) { return v < 0.0; });
+    }
+    if (omp_get_thread_num() == omp_get_max_threads() - 1 && !base2)  // The last thread
+      has_zero = std::any_of(input, input + buf_len, [](auto v) { return v == 0.0; });
   }
 
-  // Step 2: record test results
-  auto treatment = pack_8_booleans({has_neg, has_zero, false, false, false, false, false, false});
+  // Step 2: record test results. When there are both negative values and zeros, every value
+  //         is in one of three states, which are packed in base 3 (5 values per byte)
+  //         instead of being kept in two bitmasks.
+  const auto ternary = has_neg && has_zero;
+  const bool with_index = options & LOG_BLOCK_INDEX;
+  const bool base2_float = base2 && std::is_same_v<T1, float>;
+  auto treatment =
+      pack_8_booleans({has_neg, has_zero, ternary, with_index, base2, base2_float, false, false});
 
   // Step 3: calculate meta field total size, and fill in `buf_len` and `treatment`.
   auto meta_len = calc_log_meta_len(buf_len, treatment);
@@ -37,132 +417,270 @@ auto mkit::smart_log(T* buf, size_t buf_len, void** meta) -> int
   tmp_buf[8] = treatment;
   size_t pos = 9;
 
-  // Step 4: apply conditioning operations
+  // Statistics of blocks, which are gathered in the same pass when a block index is asked for.
+  const auto index_dims = dims_type{buf_len, 1, 1};
+  const auto index_block = dims_type{log_block_len, 1, 1};
+  auto stats = std::vector<BlockStats>(with_index ? (buf_len + log_block_len - 1) / log_block_len
+                                                  : 0);
+  init_block_stats(stats.data(), stats.size());
+  auto write_index = [&] {
+    if (with_index) {
+      auto index_pos = calc_log_meta_len(buf_len, treatment) -
+                       calc_block_index_len(index_dims, index_block);
+      write_block_index(index_dims, index_block, stats.data(), tmp_buf + index_pos);
+    }
+  };
+
+  // Sketches of input and output values, if asked for, are accumulated by each thread
+  //    and merged at the end.
+  auto in_locals = std::vector<Sketch>(in_sketch ? omp_get_max_threads() : 0);
+  auto out_locals = std::vector<Sketch>(out_sketch ? omp_get_max_threads() : 0);
+  auto local_sketches = [&]() -> std::pair<Sketch*, Sketch*> {
+    const auto t = omp_get_thread_num();
+    return {in_sketch ? &in_locals[t] : nullptr, out_sketch ? &out_locals[t] : nullptr};
+  };
+  auto merge_sketches = [&] {
+    for (const auto& l : in_locals)
+      in_sketch->merge(l);
+    for (const auto& l : out_locals)
+      out_sketch->merge(l);
+  };
+
+  // Step 4: apply conditioning operations in a single pass:
+  //    make all values non-negative, and then apply log operation on non-zero values.
   //
-  auto mask = Bitmask();        // will be re-used
-  const size_t stride = 16384;  // must be a multiplier of 64
-  const size_t num_strides = (buf_len - buf_len % stride) / stride;
-
-  // Step 4.1: make all values non-negative
-  if (has_neg) {
-    mask.resize(buf_len);
-    mask.reset_true();
-
-#pragma omp parallel for
-    for (size_t s = 0; s < num_strides; s++) {
-      for (size_t i = s * stride; i < (s + 1) * stride; i++) {
-        if (buf[i] < 0.0) {
-          mask.write_false(i);
-          buf[i] = std::abs(buf[i]);
+  const auto tp = tuned_params(TUNE_SMART_LOG, buf_len);
+  if (ternary) {
+    uint8_t* const states = tmp_buf + pos;
+    const size_t num_groups = (buf_len + 4) / 5;
+
+    // Each task works on `log_block_len` groups, i.e., exactly 5 blocks.
+    const size_t num_chunks = (num_groups + log_block_len - 1) / log_block_len;
+
+#pragma omp parallel for num_threads(tp.num_threads)
+    for (size_t c = 0; c < num_chunks; c++) {
+      const auto [in_local, out_local] = local_sketches();
+      const size_t group_end = std::min(num_groups, (c + 1) * log_block_len);
+      for (size_t g = c * log_block_len; g < group_end; g++) {
+        const size_t end = std::min(buf_len, g * 5 + 5);
+        uint8_t code = 0, weight = 1;
+        for (size_t i = g * 5; i < end; i++) {
+          auto v = calc_type(input[i]);
+          if (with_index)
+            stats[i / log_block_len].add(double(input[i]));
+          if (in_local)
+            in_local->add(double(input[i]));
+          uint8_t state = log_state_pos;
+          if (v < 0.0) {
+            state = log_state_neg;
+            v = -v;
+          }
+          if (v == 0.0)
+            state = log_state_zero;
+          else
+            v = std::log(v);
+          output[i] = T2(v);
+          if (out_local)
+            out_local->add(double(T2(v)));
+          code += state * weight;
+          weight *= 3;
         }
+        states[g] = code;
       }
     }
 
-    for (size_t i = stride * num_strides; i < buf_len; i++) {
-      if (buf[i] < 0.0) {
-        mask.write_false(i);
-        buf[i] = std::abs(buf[i]);
-      }
-    }
-    const auto& mask_buf = mask.view_buffer();
-    auto mask_num_bytes = mask_buf.size() * 8;
-    std::memcpy(tmp_buf + pos, mask_buf.data(), mask_num_bytes);
-    pos += mask_num_bytes;
+    write_index();
+    merge_sketches();
+    *meta = tmp_buf;
+    return 0;
   }
 
-  // Step 4.2: apply log operation on non-zero values
-  if (has_zero) {
-    mask.resize(buf_len);
-    mask.reset();
+  auto sign_mask = Bitmask(has_neg ? buf_len : 0);
+  auto zero_mask = Bitmask(has_zero ? buf_len : 0);
+  sign_mask.reset_true();
+  // The stride must be a multiple of 64, so that no two tasks write to the same mask word,
+  //    and with a block index, a multiple of `log_block_len`, so that no two tasks update
+  //    the same block.
+  const size_t stride =
+      with_index ? (tp.stride + log_block_len - 1) / log_block_len * log_block_len : tp.stride;
+  const size_t num_strides = (buf_len - buf_len % stride) / stride;
 
-#pragma omp parallel for
-    for (size_t s = 0; s < num_strides; s++) {
-      for (size_t i = s * stride; i < (s + 1) * stride; i++) {
-        if (buf[i] == 0.0)
-          mask.write_true(i);
-        else
-          buf[i] = std::log(buf[i]);
-      }
+  auto xform = [&](size_t i, Sketch* in_local, Sketch* out_local) {
+    auto v = calc_type(input[i]);
+    if (with_index)
+      stats[i / log_block_len].add(double(input[i]));
+    if (in_local)
+      in_local->add(double(input[i]));
+    if (base2) {
+      if (std::signbit(input[i]))
+        sign_mask.write_false(i);
+      v = calc_type(bits_log2(input[i]));
     }
-
-    for (size_t i = stride * num_strides; i < buf_len; i++) {
-      if (buf[i] == 0.0)
-        mask.write_true(i);
+    else {
+      if (v < 0.0) {
+        sign_mask.write_false(i);
+        v = -v;
+      }
+      if (v == 0.0)
+        zero_mask.write_true(i);
       else
-        buf[i] = std::log(buf[i]);
+        v = std::log(v);
     }
-    const auto& mask_buf = mask.view_buffer();
-    auto mask_num_bytes = mask_buf.size() * 8;
-    std::memcpy(tmp_buf + pos, mask_buf.data(), mask_num_bytes);
+    output[i] = T2(v);
+    if (out_local)
+      out_local->add(double(T2(v)));
+  };
+
+#pragma omp parallel for num_threads(tp.num_threads)
+  for (size_t s = 0; s < num_strides; s++) {
+    const auto [in_local, out_local] = local_sketches();
+    for (size_t i = s * stride; i < (s + 1) * stride; i++)
+      xform(i, in_local, out_local);
   }
-  else {
 
-#pragma omp parallel for
-    for (size_t s = 0; s < num_strides; s++) {
-      for (size_t i = s * stride; i < (s + 1) * stride; i++)
-        buf[i] = std::log(buf[i]);
-    }
+  const auto [in_local, out_local] = local_sketches();
+  for (size_t i = stride * num_strides; i < buf_len; i++)
+    xform(i, in_local, out_local);
 
-    for (size_t i = stride * num_strides; i < buf_len; i++)
-      buf[i] = std::log(buf[i]);
+  // Step 5: save the masks
+  //
+  if (has_neg) {
+    const auto& mask_buf = sign_mask.view_buffer();
+    auto mask_num_bytes = mask_buf.size() * 8;
+    std::memcpy(tmp_buf + pos, mask_buf.data(), mask_num_bytes);
+    pos += mask_num_bytes;
+  }
+  if (has_zero) {
+    const auto& mask_buf = zero_mask.view_buffer();
+    auto mask_num_bytes = mask_buf.size() * 8;
+    std::memcpy(tmp_buf + pos, mask_buf.data(), mask_num_bytes);
   }
 
+  write_index();
+  merge_sketches();
   *meta = tmp_buf;
 
   return 0;
 }
-template auto mkit::smart_log(float* buf, size_t buf_len, void** meta) -> int;
-template auto mkit::smart_log(double* buf, size_t buf_len, void** meta) -> int;
+template auto mkit::smart_log(const float*, float*, size_t, void**, uint8_t, Sketch*, Sketch*)
+    -> int;
+template auto mkit::smart_log(const float*, double*, size_t, void**, uint8_t, Sketch*, Sketch*)
+    -> int;
+template auto mkit::smart_log(const double*, float*, size_t, void**, uint8_t, Sketch*, Sketch*)
+    -> int;
+template auto mkit::smart_log(const double*, double*, size_t, void**, uint8_t, Sketch*, Sketch*)
+    -> int;
 
 template <typename T>
 auto mkit::smart_exp(T* buf, size_t buf_len, const void* meta) -> int
+{
+  return smart_exp(static_cast<const T*>(buf), buf, buf_len, meta);
+}
+template auto mkit::smart_exp(float* buf, size_t buf_len, const void* meta) -> int;
+template auto mkit::smart_exp(double* buf, size_t buf_len, const void* meta) -> int;
+
+template <typename T1, typename T2>
+auto mkit::smart_exp(const T1* input, T2* output, size_t buf_len, const void* meta) -> int
 {
   if (buf_len != static_cast<const uint64_t*>(meta)[0])
     return 1;
 
+  using calc_type = std::common_type_t<T1, T2>;
+
   // Step 1: are there negative or absolute zero values?
   //
   const uint8_t* p = static_cast<const uint8_t*>(meta);
-  auto [has_neg, has_zero, b2, b3, b4, b5, b6, b7] = unpack_8_booleans(p[8]);
+  auto [has_neg, has_zero, ternary, b3, base2, base2_float, b6, b7] = unpack_8_booleans(p[8]);
+  const auto tp = tuned_params(TUNE_SMART_EXP, buf_len);
 
-  // Step 2: apply exp to all values, then zero out ones indicated by the zero mask.
+  // Ternary states: decode 5 values per byte with a lookup table that translates a byte to
+  //    5 factors (1 for positive, -1 for negative, and 0 for zero values).
   //
-#pragma omp parallel for
-  for (size_t i = 0; i < buf_len; i++)
-    buf[i] = std::exp(buf[i]);
-
-  auto mask = Bitmask();
-  if (has_zero) {
-    // Need to figure out where zero mask is stored
-    mask.resize(buf_len);
-    size_t pos = 9;
-    if (has_neg)
-      pos += mask.view_buffer().size() * 8;
-    mask.use_bitstream(p + pos);
-
-#pragma omp parallel for
-    for (size_t i = 0; i < buf_len; i++) {
-      if (mask.read_bit(i))
-        buf[i] = 0.0;
+  if (ternary) {
+    static const auto factors = [] {
+      auto table = std::array<std::array<int8_t, 5>, 256>{};
+      for (size_t code = 0; code < 243; code++) {
+        auto c = code;
+        for (size_t k = 0; k < 5; k++, c /= 3)
+          table[code][k] = (c % 3 == log_state_pos) ? 1 : ((c % 3 == log_state_neg) ? -1 : 0);
+      }
+      return table;
+    }();
+    const uint8_t* const states = p + 9;
+    const size_t num_full = buf_len / 5;
+
+#pragma omp parallel for num_threads(tp.num_threads)
+    for (size_t g = 0; g < num_full; g++) {
+      const auto& f = factors[states[g]];
+      for (size_t k = 0; k < 5; k++) {
+        const size_t i = g * 5 + k;
+        output[i] = f[k] ? T2(f[k] * std::exp(calc_type(input[i]))) : T2{0};
+      }
+    }
+    for (size_t i = num_full * 5; i < buf_len; i++) {
+      const auto f = factors[states[num_full]][i - num_full * 5];
+      output[i] = f ? T2(f * std::exp(calc_type(input[i]))) : T2{0};
     }
+
+    return 0;
   }
 
-  // Step 3: apply negative signs if needed
+  // Step 2: locate the masks
   //
-  if (has_neg) {
-    mask.resize(buf_len);
-    mask.use_bitstream(p + 9);
+  const size_t mask_num_bytes = (buf_len + 63) / 64 * 8;
+  const auto sign_mask = BitmaskView(p + 9, has_neg ? buf_len : 0);
+  const auto zero_mask = BitmaskView(p + 9 + (has_neg ? mask_num_bytes : 0), has_zero ? buf_len : 0);
 
-#pragma omp parallel for
-    for (size_t i = 0; i < buf_len; i++)
-      if (!mask.read_bit(i))
-        buf[i] = -buf[i];
+  // Step 3: apply exp to all values, zero out ones indicated by the zero mask,
+  //         and apply negative signs if needed. Work on 64 values at a time so that
+  //         each mask word is read only once.
+  //
+  const size_t num_words = (buf_len + 63) / 64;
+
+  // In the base-2 mode, values are restored in the precision that they were transformed in,
+  //    and negated by flipping their sign bits.
+  if (base2) {
+#pragma omp parallel for num_threads(tp.num_threads)
+    for (size_t w = 0; w < num_words; w++) {
+      const uint64_t signs = has_neg ? sign_mask.read_long(w * 64) : ~uint64_t{0};
+      const size_t end = std::min(buf_len, w * 64 + 64);
+      for (size_t i = w * 64; i < end; i++) {
+        const bool neg = !(signs & (uint64_t{1} << (i % 64)));
+        if (base2_float) {
+          const auto v = bits_exp2<float>(double(input[i]));
+          output[i] = T2(neg ? -v : v);
+        }
+        else {
+          const auto v = bits_exp2<double>(double(input[i]));
+          output[i] = T2(neg ? -v : v);
+        }
+      }
+    }
+    return 0;
+  }
+
+#pragma omp parallel for num_threads(tp.num_threads)
+  for (size_t w = 0; w < num_words; w++) {
+    const uint64_t signs = has_neg ? sign_mask.read_long(w * 64) : ~uint64_t{0};
+    const uint64_t zeros = has_zero ? zero_mask.read_long(w * 64) : uint64_t{0};
+    const size_t end = std::min(buf_len, w * 64 + 64);
+    for (size_t i = w * 64; i < end; i++) {
+      const auto bit = uint64_t{1} << (i % 64);
+      auto v = std::exp(calc_type(input[i]));
+      if (zeros & bit)
+        v = 0.0;
+      if (!(signs & bit))
+        v = -v;
+      output[i] = T2(v);
+    }
   }
 
   return 0;
 }
-template auto mkit::smart_exp(float* buf, size_t buf_len, const void* meta) -> int;
-template auto mkit::smart_exp(double* buf, size_t buf_len, const void* meta) -> int;
+template auto mkit::smart_exp(const float*, float*, size_t, const void*) -> int;
+template auto mkit::smart_exp(const float*, double*, size_t, const void*) -> int;
+template auto mkit::smart_exp(const double*, float*, size_t, const void*) -> int;
+template auto mkit::smart_exp(const double*, double*, size_t, const void*) -> int;
 
 auto mkit::retrieve_log_meta_len(const void* meta) -> size_t
 {
@@ -181,123 +699,497 @@ auto mkit::retrieve_log_meta_len(const void* meta) -> size_t
 template <typename T>
 auto mkit::slice_norm(T* buf, dims_type dims, void** meta) -> int
 {
-  if (*meta != nullptr)
+  return slice_norm(static_cast<const T*>(buf), buf, dims, meta);
+}
+template auto mkit::slice_norm(float* buf, dims_type dims, void** meta) -> int;
+template auto mkit::slice_norm(double* buf, dims_type dims, void** meta) -> int;
+
+template <typename T>
+auto mkit::slice_norm(T* buf, dims_type dims, void** meta, void** preview) -> int
+{
+  return slice_norm(static_cast<const T*>(buf), buf, dims, meta, preview);
+}
+template auto mkit::slice_norm(float*, dims_type, void**, void**) -> int;
+template auto mkit::slice_norm(double*, dims_type, void**, void**) -> int;
+
+template <typename T1, typename T2>
+auto mkit::slice_norm(const T1* input, T2* output, dims_type dims, void** meta) -> int
+{
+  return slice_norm(input, output, dims, meta, nullptr, 0);
+}
+template auto mkit::slice_norm(const float*, float*, dims_type, void**) -> int;
+template auto mkit::slice_norm(const float*, double*, dims_type, void**) -> int;
+template auto mkit::slice_norm(const double*, float*, dims_type, void**) -> int;
+template auto mkit::slice_norm(const double*, double*, dims_type, void**) -> int;
+
+template <typename T1, typename T2>
+auto mkit::slice_norm(const T1* input,
+                      T2* output,
+                      dims_type dims,
+                      void** meta,
+                      void** preview) -> int
+{
+  return slice_norm(input, output, dims, meta, preview, 0);
+}
+template auto mkit::slice_norm(const float*, float*, dims_type, void**, void**) -> int;
+template auto mkit::slice_norm(const float*, double*, dims_type, void**, void**) -> int;
+template auto mkit::slice_norm(const double*, float*, dims_type, void**, void**) -> int;
+template auto mkit::slice_norm(const double*, double*, dims_type, void**, void**) -> int;
+
+template <typename T1, typename T2>
+auto mkit::slice_norm(const T1* input,
+                      T2* output,
+                      dims_type dims,
+                      void** meta,
+                      void** preview,
+                      uint8_t options) -> int
+{
+  return slice_norm(input, output, dims, meta, preview, options, nullptr, nullptr);
+}
+template auto mkit::slice_norm(const float*, float*, dims_type, void**, void**, uint8_t) -> int;
+template auto mkit::slice_norm(const float*, double*, dims_type, void**, void**, uint8_t) -> int;
+template auto mkit::slice_norm(const double*, float*, dims_type, void**, void**, uint8_t) -> int;
+template auto mkit::slice_norm(const double*, double*, dims_type, void**, void**, uint8_t)
+    -> int;
+
+template <typename T1, typename T2>
+auto mkit::slice_norm(const T1* input,
+                      T2* output,
+                      dims_type dims,
+                      void** meta,
+                      void** preview,
+                      uint8_t options,
+                      Sketch* in_sketch,
+                      Sketch* out_sketch) -> int
+{
+  if (*meta != nullptr || (preview && *preview != nullptr) || (options & ~NORM_BLOCK_INDEX))
     return 1;
 
-  // In case of 2D slices, really does nothing, just record a header size of 4 bytes.
+  using calc_type = std::common_type_t<T1, T2>;
+  const auto total_vals = dims[0] * dims[1] * dims[2];
+  const bool with_index = options & NORM_BLOCK_INDEX;
+  const auto index_block = dims_type{std::min(norm_block_dim, dims[0]),
+                                     std::min(norm_block_dim, dims[1]),
+                                     std::min(norm_block_dim, dims[2])};
+  const auto index_len = with_index ? calc_block_index_len(dims, index_block) : 0;
+
+  // In case of 2D slices, really does nothing, just record a header size of 4 bytes
+  //    (followed by the block index if asked for).
   //
   if (dims[2] == 1) {
-    uint32_t header_len = sizeof(uint32_t);
-    void* tmp_buf = std::malloc(header_len);
+    if (preview)
+      preview_pyramid(input, dims, preview);
+    if (in_sketch)
+      in_sketch->add(input, total_vals);
+    if (out_sketch)
+      out_sketch->add(input, total_vals);
+    void* index = nullptr;
+    if (with_index)
+      block_index(input, dims, index_block, &index);
+    if (static_cast<const void*>(input) != static_cast<const void*>(output))
+      std::copy(input, input + total_vals, output);
+    uint32_t header_len = sizeof(uint32_t) + index_len;
+    uint8_t* tmp_buf = static_cast<uint8_t*>(std::malloc(header_len));
     std::memcpy(tmp_buf, &header_len, sizeof(header_len));
+    if (index) {
+      std::memcpy(tmp_buf + sizeof(uint32_t), index, index_len);
+      std::free(index);
+    }
     *meta = tmp_buf;
     return 0;
   }
 
   // Filter header definition:
-  // Total_length (uint32_t) +  slice means (double) + slice rms (double)
+  // Total_length (uint32_t) +  slice means (double) + slice rms (double) +
+  //    optionally the block index
   //
   const auto dimx = dims[0];
   const auto xy = dims[0] * dims[1];
   const auto yz = double(dims[1] * dims[2]);
-  const auto total_vals = dims[0] * dims[1] * dims[2];
-  const uint32_t header_len = sizeof(uint32_t) + sizeof(double) * 2 * dimx;
+  if (sizeof(uint32_t) + sizeof(double) * 2 * dimx + index_len > UINT32_MAX)
+    return 1;
+  const uint32_t header_len = sizeof(uint32_t) + sizeof(double) * 2 * dimx + index_len;
   uint8_t* tmp_buf = static_cast<uint8_t*>(std::malloc(header_len));
   std::memcpy(tmp_buf, &header_len, sizeof(header_len));
 
-  // Create a buffer for each OMP thread.
+  // Create a buffer of partial sums for each OMP thread.
   //
-  auto buf_vec = std::vector<std::unique_ptr<double[]>>(omp_get_max_threads());
-  for (size_t i = 0; i < buf_vec.size(); i++) {
-    buf_vec[i] = std::make_unique<double[]>(dimx);
-    std::fill(buf_vec[i].get(), buf_vec[i].get() + dimx, 0.0);
-  }
+  const auto tp = tuned_params(TUNE_SLICE_NORM, total_vals);
+  auto partials = Partials(tp.num_threads, dimx);
 
-  // First pass: calculate mean
+  // First pass: calculate mean. Sums of the 2x preview level and block statistics are also
+  //    accumulated in the same traversal when asked for. Every task works on a tile of a
+  //    group of planes by a range of rows, which make up whole cells of the preview level
+  //    and whole blocks, so that no two tasks update the same cell or block.
   //
   double* const mean_buf = reinterpret_cast<double*>(tmp_buf + sizeof(header_len));
 
-#pragma omp parallel for
-  for (size_t z = 0; z < dims[2]; z++) {
-    auto& mybuf = buf_vec[omp_get_thread_num()];
-    for (size_t i = z * xy; i < (z + 1) * xy; i++)
-      mybuf[i % dimx] += double(buf[i]);
-  }
+  const auto pd = preview_level_dims(dims, 1);
+  auto sums = std::vector<double>(preview ? pd[0] * pd[1] * pd[2] : 0, 0.0);
+  const size_t nbx = (dims[0] + index_block[0] - 1) / index_block[0];
+  const size_t nby = (dims[1] + index_block[1] - 1) / index_block[1];
+  const size_t nbz = (dims[2] + index_block[2] - 1) / index_block[2];
+  auto stats = std::vector<BlockStats>(with_index ? nbx * nby * nbz : 0);
+  init_block_stats(stats.data(), stats.size());
 
-  for (auto& buf : buf_vec) {
-    for (size_t i = 0; i < dimx; i++)
-      mean_buf[i] += buf[i];
-  }
-  std::for_each(mean_buf, mean_buf + dimx, [yz](auto& v) { v /= yz; });
+  const size_t group = with_index ? index_block[2] : (preview ? 2 : 1);
+  const size_t y_unit = with_index ? index_block[1] : (preview ? 2 : 1);
+  const auto tiles = Tiles(dims, group, y_unit, tp.num_threads);
 
-// Second pass: subtract mean
-//
-#pragma omp parallel for
-  for (size_t i = 0; i < total_vals; i++) {
-    buf[i] -= T(mean_buf[i % dimx]);
+  // Sketches of input and output values, if asked for, are accumulated by each thread
+  //    and merged at the end.
+  auto in_locals = std::vector<Sketch>(in_sketch ? omp_get_max_threads() : 0);
+  auto out_locals = std::vector<Sketch>(out_sketch ? omp_get_max_threads() : 0);
+
+#pragma omp parallel num_threads(tp.num_threads)
+  {
+#pragma omp for schedule(static, 1)
+    for (size_t r = 0; r < partials.num_rows(); r++)
+      partials.clear(r);
+
+    double* const mybuf = partials.row(omp_get_thread_num());
+    Sketch* in_local = in_sketch ? &in_locals[omp_get_thread_num()] : nullptr;
+#pragma omp for
+    for (size_t t = 0; t < tiles.count(); t++) {
+      const size_t z_begin = t / tiles.num_y * tiles.z_group;
+      const size_t y_begin = t % tiles.num_y * tiles.y_tile;
+      for (size_t z = z_begin; z < std::min(dims[2], z_begin + tiles.z_group); z++)
+        for (size_t y = y_begin; y < std::min(dims[1], y_begin + tiles.y_tile); y++) {
+          const T1* row = input + z * xy + y * dimx;
+          for (size_t x = 0; x < dimx; x++)
+            mybuf[x] += double(row[x]);
+          if (in_local) {
+            for (size_t x = 0; x < dimx; x++)
+              in_local->add(double(row[x]));
+          }
+          if (preview) {
+            double* cell = sums.data() + (z / 2 * pd[1] + y / 2) * pd[0];
+            for (size_t x = 0; x < dimx; x++)
+              cell[x / 2] += double(row[x]);
+          }
+          if (with_index) {
+            BlockStats* blk =
+                stats.data() + (z / index_block[2] * nby + y / index_block[1]) * nbx;
+            for (size_t x = 0; x < dimx; x++)
+              blk[x / index_block[0]].add(double(row[x]));
+          }
+        }
+    }
   }
 
-  // Third pass: calculate RMS
+  if (preview)
+    *preview = finish_preview(dims, sums.data());
+  if (with_index)
+    write_block_index(dims, index_block, stats.data(), mean_buf + 2 * dimx);
+
+  partials.merge(mean_buf, tp.num_threads);
+  std::for_each(mean_buf, mean_buf + dimx, [yz](auto& v) { v /= yz; });
+
+  // Second pass: calculate RMS of the mean-subtracted values
   //
   double* const rms_buf = mean_buf + dimx;
+  const auto row_tiles = Tiles(dims, 1, 1, tp.num_threads);
 
-#pragma omp parallel for
-  for (size_t i = 0; i < buf_vec.size(); i++)
-    std::fill(buf_vec[i].get(), buf_vec[i].get() + dimx, 0.0);
-
-#pragma omp parallel for
-  for (size_t z = 0; z < dims[2]; z++) {
-    auto& mybuf = buf_vec[omp_get_thread_num()];
-    for (size_t i = z * xy; i < (z + 1) * xy; i++)
-      mybuf[i % dimx] += double(buf[i] * buf[i]);
+#pragma omp parallel num_threads(tp.num_threads)
+  {
+#pragma omp for schedule(static, 1)
+    for (size_t r = 0; r < partials.num_rows(); r++)
+      partials.clear(r);
+
+    double* const mybuf = partials.row(omp_get_thread_num());
+#pragma omp for
+    for (size_t t = 0; t < row_tiles.count(); t++) {
+      const size_t z = t / row_tiles.num_y;
+      const size_t y_begin = t % row_tiles.num_y * row_tiles.y_tile;
+      for (size_t y = y_begin; y < std::min(dims[1], y_begin + row_tiles.y_tile); y++) {
+        const T1* row = input + z * xy + y * dimx;
+        for (size_t x = 0; x < dimx; x++) {
+          auto v = calc_type(row[x]) - calc_type(mean_buf[x]);
+          mybuf[x] += double(v * v);
+        }
+      }
+    }
   }
 
-  for (auto& buf : buf_vec) {
-    for (size_t i = 0; i < dimx; i++)
-      rms_buf[i] += buf[i];
-  }
+  partials.merge(rms_buf, tp.num_threads);
   std::for_each(rms_buf, rms_buf + dimx, [yz](auto& v) {
     v /= yz;
     v = std::sqrt(v);
   });
   std::replace(rms_buf, rms_buf + dimx, 0.0, 1.0);
 
-// Fourth pass: divide by RMS
-//
-#pragma omp parallel for
-  for (size_t i = 0; i < total_vals; i++)
-    buf[i] /= T(rms_buf[i % dimx]);
+  // Third pass: subtract mean and divide by RMS
+  //
+  if (out_sketch == nullptr) {
+#pragma omp parallel for num_threads(tp.num_threads)
+    for (size_t i = 0; i < total_vals; i++) {
+      auto v = calc_type(input[i]) - calc_type(mean_buf[i % dimx]);
+      output[i] = T2(v / calc_type(rms_buf[i % dimx]));
+    }
+  }
+  else {
+#pragma omp parallel num_threads(tp.num_threads)
+    {
+      auto& out_local = out_locals[omp_get_thread_num()];
+#pragma omp for
+      for (size_t i = 0; i < total_vals; i++) {
+        auto v = calc_type(input[i]) - calc_type(mean_buf[i % dimx]);
+        const auto out = T2(v / calc_type(rms_buf[i % dimx]));
+        output[i] = out;
+        out_local.add(double(out));
+      }
+    }
+  }
+
+  for (const auto& l : in_locals)
+    in_sketch->merge(l);
+  for (const auto& l : out_locals)
+    out_sketch->merge(l);
 
   *meta = tmp_buf;
   return 0;
 }
-template auto mkit::slice_norm(float* buf, dims_type dims, void** meta) -> int;
-template auto mkit::slice_norm(double* buf, dims_type dims, void** meta) -> int;
+template auto mkit::slice_norm(const float*,
+                               float*,
+                               dims_type,
+                               void**,
+                               void**,
+                               uint8_t,
+                               Sketch*,
+                               Sketch*) -> int;
+template auto mkit::slice_norm(const float*,
+                               double*,
+                               dims_type,
+                               void**,
+                               void**,
+                               uint8_t,
+                               Sketch*,
+                               Sketch*) -> int;
+template auto mkit::slice_norm(const double*,
+                               float*,
+                               dims_type,
+                               void**,
+                               void**,
+                               uint8_t,
+                               Sketch*,
+                               Sketch*) -> int;
+template auto mkit::slice_norm(const double*,
+                               double*,
+                               dims_type,
+                               void**,
+                               void**,
+                               uint8_t,
+                               Sketch*,
+                               Sketch*) -> int;
 
 template <typename T>
 auto mkit::inv_slice_norm(T* buf, dims_type dims, const void* meta) -> int
 {
+  return inv_slice_norm(static_cast<const T*>(buf), buf, dims, meta);
+}
+template auto mkit::inv_slice_norm(float* buf, dims_type dims, const void* meta) -> int;
+template auto mkit::inv_slice_norm(double* buf, dims_type dims, const void* meta) -> int;
+
+template <typename T1, typename T2>
+auto mkit::inv_slice_norm(const T1* input, T2* output, dims_type dims, const void* meta) -> int
+{
+  using calc_type = std::common_type_t<T1, T2>;
+  const auto total_vals = dims[0] * dims[1] * dims[2];
+
   // In case of 2D slices, really does nothing.
   //
-  if (dims[2] == 1)
+  if (dims[2] == 1) {
+    if (static_cast<const void*>(input) != static_cast<const void*>(output))
+      std::copy(input, input + total_vals, output);
     return 0;
+  }
 
   const auto dimx = dims[0];
-  const auto total_vals = dims[0] * dims[1] * dims[2];
   const double* const mean_buf =
       reinterpret_cast<const double*>(static_cast<const uint8_t*>(meta) + 4);
   const double* const rms_buf = mean_buf + dimx;
+  const auto tp = tuned_params(TUNE_INV_SLICE_NORM, total_vals);
 
-#pragma omp parallel for
+#pragma omp parallel for num_threads(tp.num_threads)
   for (size_t i = 0; i < total_vals; i++) {
-    buf[i] *= T(rms_buf[i % dimx]);
-    buf[i] += T(mean_buf[i % dimx]);
+    auto v = calc_type(input[i]) * calc_type(rms_buf[i % dimx]);
+    output[i] = T2(v + calc_type(mean_buf[i % dimx]));
   }
 
   return 0;
 }
-template auto mkit::inv_slice_norm(float* buf, dims_type dims, const void* meta) -> int;
-template auto mkit::inv_slice_norm(double* buf, dims_type dims, const void* meta) -> int;
+template auto mkit::inv_slice_norm(const float*, float*, dims_type, const void*) -> int;
+template auto mkit::inv_slice_norm(const float*, double*, dims_type, const void*) -> int;
+template auto mkit::inv_slice_norm(const double*, float*, dims_type, const void*) -> int;
+template auto mkit::inv_slice_norm(const double*, double*, dims_type, const void*) -> int;
+
+template <typename T>
+auto mkit::slice_norm_stale(T* buf,
+                            dims_type dims,
+                            const void* stats,
+                            void** meta,
+                            void** next_stats,
+                            double* drift) -> int
+{
+  return slice_norm_stale(static_cast<const T*>(buf), buf, dims, stats, meta, next_stats, drift);
+}
+template auto mkit::slice_norm_stale(float*, dims_type, const void*, void**, void**, double*)
+    -> int;
+template auto mkit::slice_norm_stale(double*, dims_type, const void*, void**, void**, double*)
+    -> int;
+
+template <typename T1, typename T2>
+auto mkit::slice_norm_stale(const T1* input,
+                            T2* output,
+                            dims_type dims,
+                            const void* stats,
+                            void** meta,
+                            void** next_stats,
+                            double* drift) -> int
+{
+  if (*meta != nullptr || (next_stats && *next_stats != nullptr))
+    return 1;
+
+  using calc_type = std::common_type_t<T1, T2>;
+  const auto total_vals = dims[0] * dims[1] * dims[2];
+  const auto stats_len = retrieve_slice_norm_meta_len(stats);
+
+  // In case of 2D slices, there are no statistics to apply or to refresh.
+  //
+  if (dims[2] == 1) {
+    if (stats_len < sizeof(uint32_t))
+      return 1;
+    if (static_cast<const void*>(input) != static_cast<const void*>(output))
+      std::copy(input, input + total_vals, output);
+    const uint32_t header_len = sizeof(uint32_t);
+    for (void** dst : {meta, next_stats}) {
+      if (dst) {
+        *dst = std::malloc(header_len);
+        std::memcpy(*dst, &header_len, sizeof(header_len));
+      }
+    }
+    if (drift)
+      *drift = 0.0;
+    return 0;
+  }
+
+  // `stats` needs to be the meta data of a volume with the same dimensions, with or
+  //    without a block index.
+  const auto dimx = dims[0];
+  const auto xy = dims[0] * dims[1];
+  const size_t header_len = sizeof(uint32_t) + sizeof(double) * 2 * dimx;
+  const auto index_block = dims_type{std::min(norm_block_dim, dims[0]),
+                                     std::min(norm_block_dim, dims[1]),
+                                     std::min(norm_block_dim, dims[2])};
+  if (header_len > UINT32_MAX ||
+      (stats_len != header_len &&
+       stats_len != header_len + calc_block_index_len(dims, index_block)))
+    return 1;
+
+  uint8_t* tmp_buf = static_cast<uint8_t*>(std::malloc(header_len));
+  const auto len32 = uint32_t(header_len);
+  std::memcpy(tmp_buf, &len32, sizeof(len32));
+  std::memcpy(tmp_buf + sizeof(len32), static_cast<const uint8_t*>(stats) + sizeof(len32),
+              header_len - sizeof(len32));
+  const double* const mean_buf = reinterpret_cast<const double*>(tmp_buf + sizeof(len32));
+  const double* const rms_buf = mean_buf + dimx;
+
+  // A single pass applies the given statistics. When the statistics are also refreshed,
+  //    sums of values and of their squares are accumulated in the same pass, both shifted
+  //    by the given means: they are close to the actual means, so the variance is found
+  //    from these sums without much cancellation.
+  //
+  const bool refresh = next_stats || drift;
+  const auto tp = tuned_params(TUNE_SLICE_NORM, total_vals);
+  auto partials = Partials(refresh ? tp.num_threads : 0, 2 * dimx);
+  const auto tiles = Tiles(dims, 1, 1, tp.num_threads);
+
+#pragma omp parallel num_threads(tp.num_threads)
+  {
+#pragma omp for schedule(static, 1)
+    for (size_t r = 0; r < partials.num_rows(); r++)
+      partials.clear(r);
+
+    double* const sum = refresh ? partials.row(omp_get_thread_num()) : nullptr;
+#pragma omp for
+    for (size_t t = 0; t < tiles.count(); t++) {
+      const size_t z = t / tiles.num_y;
+      const size_t y_begin = t % tiles.num_y * tiles.y_tile;
+      for (size_t y = y_begin; y < std::min(dims[1], y_begin + tiles.y_tile); y++) {
+        const size_t row = z * xy + y * dimx;
+        for (size_t x = 0; x < dimx; x++) {
+          const auto v = calc_type(input[row + x]) - calc_type(mean_buf[x]);
+          output[row + x] = T2(v / calc_type(rms_buf[x]));
+          if (sum) {
+            sum[x] += double(v);
+            sum[dimx + x] += double(v) * double(v);
+          }
+        }
+      }
+    }
+  }
+
+  if (refresh) {
+    const auto yz = double(dims[1] * dims[2]);
+    uint8_t* next_buf = static_cast<uint8_t*>(std::malloc(header_len));
+    std::memcpy(next_buf, &len32, sizeof(len32));
+    double* const next_mean = reinterpret_cast<double*>(next_buf + sizeof(len32));
+    double* const next_rms = next_mean + dimx;
+    partials.merge(next_mean, tp.num_threads);
+
+    // Drift of a slice is the change of its mean in units of the old RMS, or the relative
+    //    change of its RMS, whichever is larger.
+    auto max_drift = 0.0;
+    for (size_t x = 0; x < dimx; x++) {
+      const auto shift = next_mean[x] / yz;
+      auto rms = std::sqrt(std::max(0.0, next_rms[x] / yz - shift * shift));
+      if (rms == 0.0)
+        rms = 1.0;
+      next_mean[x] = mean_buf[x] + shift;
+      next_rms[x] = rms;
+      max_drift = std::max({max_drift, std::abs(shift) / rms_buf[x],
+                            std::abs(rms / rms_buf[x] - 1.0)});
+    }
+
+    if (drift)
+      *drift = max_drift;
+    if (next_stats)
+      *next_stats = next_buf;
+    else
+      std::free(next_buf);
+  }
+
+  *meta = tmp_buf;
+  return 0;
+}
+template auto mkit::slice_norm_stale(const float*,
+                                     float*,
+                                     dims_type,
+                                     const void*,
+                                     void**,
+                                     void**,
+                                     double*) -> int;
+template auto mkit::slice_norm_stale(const float*,
+                                     double*,
+                                     dims_type,
+                                     const void*,
+                                     void**,
+                                     void**,
+                                     double*) -> int;
+template auto mkit::slice_norm_stale(const double*,
+                                     float*,
+                                     dims_type,
+                                     const void*,
+                                     void**,
+                                     void**,
+                                     double*) -> int;
+template auto mkit::slice_norm_stale(const double*,
+                                     double*,
+                                     dims_type,
+                                     const void*,
+                                     void**,
+                                     void**,
+                                     double*) -> int;
 
 auto mkit::retrieve_slice_norm_meta_len(const void* meta) -> size_t
 {
@@ -315,43 +1207,63 @@ auto mkit::retrieve_slice_norm_meta_len(const void* meta) -> size_t
 template <typename T>
 auto mkit::bitmask_zero(const T* input, size_t len, void** output) -> int
 {
-  if (*output != nullptr)
+  return bitmask_zero(input, len, output, 0);
+}
+template auto mkit::bitmask_zero(const float*, size_t, void**) -> int;
+template auto mkit::bitmask_zero(const double*, size_t, void**) -> int;
+
+template <typename T>
+auto mkit::bitmask_zero(const T* input, size_t len, void** output, uint8_t options) -> int
+{
+  if (*output != nullptr || (options & ~BZ_ALL_OPTIONS) || (options & BZ_VALUE_LIST))
+    return 1;
+  if ((options & BZ_GORILLA) && (options & BZ_SHUFFLE_ALL))
     return 1;
 
+  // NaNs are treated as zeros too.
   const auto eps = T{1e-11};
-  auto mask = Bitmask(len);
-  mask.reset_true();
-  auto nonzero = std::vector<T>();
-  nonzero.reserve(len / 16);
-  for (size_t i = 0; i < len; i++)
-    if (std::abs(input[i]) > eps) {
-      mask.write_false(i);
-      nonzero.push_back(input[i]);
-    }
-  const auto& mask_buf = mask.view_buffer();
-
-  // Header definition:
-  // precision (1 byte) + input_num_vals (8 byte) + nonzero_num_vals (8 byte)
-  //
-  const auto header_len = 17ul;                         // In bytes
-  auto mask_len = mask_buf.size() * sizeof(long);       // In bytes
-  auto nonzero_len = nonzero.size() * sizeof(T);        // In bytes
-  auto total_len = header_len + mask_len + nonzero_len; // In bytes
-
-  uint8_t* buf = static_cast<uint8_t*>(std::malloc(total_len));
-  buf[0] = std::is_same_v<T, float>;          // Save precision
-  std::memcpy(&buf[1], &len, sizeof(len));    // Save input_num_vals
-  size_t nonzero_vals = nonzero.size();
-  std::memcpy(&buf[9], &nonzero_vals, sizeof(nonzero_vals));  // Save nonzero_num_vals
-  std::memcpy(&buf[header_len], mask_buf.data(), mask_len);               // Save the mask
-  std::memcpy(&buf[header_len + mask_len], nonzero.data(), nonzero_len);  // Save nonzero vals
+  auto match = [eps](T v) { return std::abs(v) > eps ? -1 : 0; };
+  return encode_bitmask(input, len, match, std::vector<T>(), options, output);
+}
+template auto mkit::bitmask_zero(const float*, size_t, void**, uint8_t) -> int;
+template auto mkit::bitmask_zero(const double*, size_t, void**, uint8_t) -> int;
 
-  *output = buf;
+template <typename T>
+auto mkit::bitmask_value(const T* input,
+                         size_t len,
+                         const std::type_identity_t<T>* fills,
+                         size_t num_fills,
+                         void** output,
+                         uint8_t options) -> int
+{
+  if (*output != nullptr || (options & ~BZ_ALL_OPTIONS) || num_fills > bitmask_value_max_fills)
+    return 1;
+  if ((options & BZ_GORILLA) && (options & BZ_SHUFFLE_ALL))
+    return 1;
 
-  return 0;
+  auto fill_vec = fills ? std::vector<T>(fills, fills + num_fills)
+                        : dominant_values(input, len, num_fills);
+
+  // Values are matched by their bits, so that the operation is lossless for any fill value,
+  //    including NaNs and negative zeros.
+  using uint_type = std::conditional_t<std::is_same_v<T, float>, uint32_t, uint64_t>;
+  auto fill_bits = std::array<uint_type, bitmask_value_max_fills>{};
+  for (size_t k = 0; k < fill_vec.size(); k++)
+    fill_bits[k] = std::bit_cast<uint_type>(fill_vec[k]);
+  const size_t nf = fill_vec.size();
+  auto match = [fill_bits, nf](T v) {
+    const auto bits = std::bit_cast<uint_type>(v);
+    int idx = -1;
+    for (size_t k = nf; k-- > 0;)
+      idx = (bits == fill_bits[k]) ? int(k) : idx;
+    return idx;
+  };
+  return encode_bitmask(input, len, match, fill_vec, options | BZ_VALUE_LIST, output);
 }
-template auto mkit::bitmask_zero(const float*, size_t, void**) -> int;
-template auto mkit::bitmask_zero(const double*, size_t, void**) -> int;
+template auto mkit::bitmask_value(const float*, size_t, const float*, size_t, void**, uint8_t)
+    -> int;
+template auto mkit::bitmask_value(const double*, size_t, const double*, size_t, void**, uint8_t)
+    -> int;
 
 auto mkit::inv_bitmask_zero(const void* input, void** output) -> int
 {
@@ -359,34 +1271,61 @@ auto mkit::inv_bitmask_zero(const void* input, void** output) -> int
     return 1;
 
   const uint8_t* const p = static_cast<const uint8_t*>(input);
-  bool is_float = p[0];
-  const auto header_len = 17ul;
-  size_t total_vals = 0;
+  bool is_float = p[0] & 1;
+  const uint8_t options = p[0] & ~uint8_t{1};
+  if (options & ~BZ_ALL_OPTIONS)  // Produced by a newer version
+    return 1;
+  size_t total_vals = 0, other_vals = 0;
   std::memcpy(&total_vals, &p[1], sizeof(total_vals));
-  auto mask = Bitmask(total_vals);
-  const auto mask_len = mask.view_buffer().size() * sizeof(long);
-  mask.use_bitstream(p + header_len);
+  std::memcpy(&other_vals, &p[9], sizeof(other_vals));
+  const size_t width = is_float ? sizeof(float) : sizeof(double);
+  const size_t num_fills = (options & BZ_VALUE_LIST) ? p[bz_header_len] : 0;
+  if (num_fills > bitmask_value_max_fills)  // Corrupt, or produced by a newer version
+    return 1;
+  const uint8_t* const fills = p + bz_header_len + 1;
+  const size_t mask_pos = bz_mask_pos(width, num_fills, options);
+
+  // Decode the mask to its plain form if it was coded adaptively.
+  auto mask_words = std::vector<uint64_t>();
+  auto mask_len = (total_vals + 63) / 64 * 8;
+  const uint8_t* mask_buf = p + mask_pos;
+  if (options & BZ_ADAPTIVE) {
+    mask_words.resize((total_vals + 63) / 64);
+    adaptive_mask_decode(p + mask_pos, total_vals, mask_words.data());
+    mask_len = retrieve_adaptive_mask_len(p + mask_pos, total_vals);
+    mask_buf = reinterpret_cast<const uint8_t*>(mask_words.data());
+  }
+  const auto mask = BitmaskView(mask_buf, total_vals);
+  const uint8_t* const selectors = p + mask_pos + mask_len;
+
+  // Restore other values to their natural layout if they were shuffled or coded.
+  auto unshuffled = std::vector<uint8_t>();
+  const uint8_t* others =
+      p + bz_prefix_len(total_vals, other_vals, width, num_fills, options, mask_len);
+  if (options & BZ_SHUFFLE_ALL) {
+    unshuffled.resize(other_vals * width);
+    unshuffle_bytes(others, other_vals, width, (options & BZ_SHUFFLE_ALL) >> 2,
+                    unshuffled.data());
+    others = unshuffled.data();
+  }
+  else if (options & BZ_GORILLA) {
+    unshuffled.resize(other_vals * width);
+    gorilla_decode(others, other_vals, width, unshuffled.data());
+    others = unshuffled.data();
+  }
 
   if (is_float) {
-    const float* src = reinterpret_cast<const float*>(p + header_len + mask_len);
+    auto fill_vals = std::array<float, bitmask_value_max_fills>{};
+    std::memcpy(fill_vals.data(), fills, num_fills * sizeof(float));
     float* dst = static_cast<float*>(std::malloc(total_vals * sizeof(float)));
-    std::fill_n(dst, total_vals, 0.0f);
-    size_t counter = 0;
-    for (size_t i = 0; i < total_vals; i++) {
-      if (!mask.read_bit(i))
-        dst[i] = src[counter++];
-    }
+    scatter_others(mask, others, total_vals, fill_vals.data(), num_fills, selectors, dst);
     *output = dst;
   }
   else {
-    const double* src = reinterpret_cast<const double*>(p + header_len + mask_len);
+    auto fill_vals = std::array<double, bitmask_value_max_fills>{};
+    std::memcpy(fill_vals.data(), fills, num_fills * sizeof(double));
     double* dst = static_cast<double*>(std::malloc(total_vals * sizeof(double)));
-    std::fill_n(dst, total_vals, 0.0);
-    size_t counter = 0;
-    for (size_t i = 0; i < total_vals; i++) {
-      if (!mask.read_bit(i))
-        dst[i] = src[counter++];
-    }
+    scatter_others(mask, others, total_vals, fill_vals.data(), num_fills, selectors, dst);
     *output = dst;
   }
 
@@ -396,20 +1335,23 @@ auto mkit::inv_bitmask_zero(const void* input, void** output) -> int
 auto mkit::retrieve_bitmask_zero_buf_len(const void* input) -> size_t
 {
   const uint8_t* const p = static_cast<const uint8_t*>(input);
-  bool is_float = p[0];
-  size_t total_vals = 0, nonzero_vals = 0, header_len = 17;
+  bool is_float = p[0] & 1;
+  const uint8_t options = p[0] & ~uint8_t{1};
+  size_t total_vals = 0, other_vals = 0;
   std::memcpy(&total_vals, &p[1], sizeof(total_vals));
-  std::memcpy(&nonzero_vals, &p[9], sizeof(nonzero_vals));
-  auto mask = Bitmask(total_vals);
-  auto mask_len = mask.view_buffer().size() * sizeof(long);
-  if (is_float) {
-    auto rtn = header_len + mask_len + nonzero_vals * sizeof(float);
-    return rtn;
-  }
-  else {
-    auto rtn = header_len + mask_len + nonzero_vals * sizeof(double);
-    return rtn;
-  }
+  std::memcpy(&other_vals, &p[9], sizeof(other_vals));
+  const size_t width = is_float ? sizeof(float) : sizeof(double);
+  const size_t num_fills = (options & BZ_VALUE_LIST) ? p[bz_header_len] : 0;
+  const size_t mask_len =
+      (options & BZ_ADAPTIVE)
+          ? retrieve_adaptive_mask_len(p + bz_mask_pos(width, num_fills, options), total_vals)
+          : (total_vals + 63) / 64 * 8;
+  const auto prefix_len =
+      bz_prefix_len(total_vals, other_vals, width, num_fills, options, mask_len);
+  if (options & BZ_GORILLA)
+    return prefix_len + retrieve_gorilla_len(p + prefix_len, other_vals);
+  else
+    return prefix_len + bz_stream_len(other_vals, width, options);
 }
 
 //
@@ -443,13 +1385,43 @@ auto mkit::calc_log_meta_len(size_t buf_len, uint8_t treatment) -> size_t
   auto num_long = buf_len / 64;
   if (buf_len % 64 != 0)
     num_long++;
-  auto [has_neg, has_zero, b2, b3, b4, b5, b6, b7] = unpack_8_booleans(treatment);
+  auto [has_neg, has_zero, ternary, has_index, b4, b5, b6, b7] = unpack_8_booleans(treatment);
 
   auto meta_len = size_t{9};  // The fixed len field + treatment field.
-  if (has_neg)
-    meta_len += num_long * 8;
-  if (has_zero)
-    meta_len += num_long * 8;
+  if (ternary)
+    meta_len += (buf_len + 4) / 5;
+  else {
+    if (has_neg)
+      meta_len += num_long * 8;
+    if (has_zero)
+      meta_len += num_long * 8;
+  }
+  if (has_index)
+    meta_len += calc_block_index_len({buf_len, 1, 1}, {log_block_len, 1, 1});
 
   return meta_len;
 }
+
+auto mkit::calc_bitmask_zero_buf_len(size_t num_vals,
+                                     size_t num_nonzero,
+                                     size_t width,
+                                     uint8_t options) -> size_t
+{
+  return calc_bitmask_value_buf_len(num_vals, num_nonzero, width, 0, options);
+}
+
+auto mkit::calc_bitmask_value_buf_len(size_t num_vals,
+                                      size_t num_others,
+                                      size_t width,
+                                      size_t num_fills,
+                                      uint8_t options) -> size_t
+{
+  const size_t mask_len = (options & BZ_ADAPTIVE) ? calc_adaptive_mask_max_len(num_vals)
+                                                  : (num_vals + 63) / 64 * 8;
+  const size_t prefix_len =
+      bz_prefix_len(num_vals, num_others, width, num_fills, options, mask_len);
+  if (options & BZ_GORILLA)
+    return prefix_len + calc_gorilla_max_len(num_others, width);
+  else
+    return prefix_len + bz_stream_len(num_others, width, options);
+}
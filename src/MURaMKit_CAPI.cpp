@@ -1,6 +1,16 @@
 #include "MURaMKit_CAPI.h"
 
+#include "Async.h"
+#include "Container.h"
 #include "MURaMKit.h"
+#include "MaskStore.h"
+#include "Sketch.h"
+#include "Tune.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <future>
 
 int C_API::mkit_smart_log(void* buf, int is_float, size_t buf_len, void** meta)
 {
@@ -61,6 +71,29 @@ int C_API::mkit_slice_norm(void* buf,
   }
 }
 
+int C_API::mkit_slice_norm_stale(void* buf,
+                                 int is_float,
+                                 size_t dim_fast,
+                                 size_t dim_mid,
+                                 size_t dim_slow,
+                                 const void* stats,
+                                 void** meta,
+                                 void** next_stats,
+                                 double* drift)
+{
+  const auto dims = mkit::dims_type{dim_fast, dim_mid, dim_slow};
+  switch (is_float) {
+    case 0:
+      return mkit::slice_norm_stale(static_cast<double*>(buf), dims, stats, meta, next_stats,
+                                    drift);
+    case 1:
+      return mkit::slice_norm_stale(static_cast<float*>(buf), dims, stats, meta, next_stats,
+                                    drift);
+    default:
+      return -1;
+  }
+}
+
 int C_API::mkit_inv_slice_norm(void* buf,
                                int is_float,
                                size_t dim_fast,
@@ -88,6 +121,438 @@ size_t C_API::mkit_slice_norm_meta_len(const void* meta)
   return mkit::retrieve_slice_norm_meta_len(meta);
 }
 
+int C_API::mkit_slice_norm_preview(void* buf,
+                                   int is_float,
+                                   size_t dim_fast,
+                                   size_t dim_mid,
+                                   size_t dim_slow,
+                                   void** meta,
+                                   void** preview)
+{
+  const auto dims = mkit::dims_type{dim_fast, dim_mid, dim_slow};
+  switch (is_float) {
+    case 0: {
+      double* bufd = static_cast<double*>(buf);
+      return mkit::slice_norm(bufd, dims, meta, preview);
+    }
+    case 1: {
+      float* buff = static_cast<float*>(buf);
+      return mkit::slice_norm(buff, dims, meta, preview);
+    }
+    default:
+      return -1;
+  }
+}
+
+int C_API::mkit_preview_pyramid(const void* buf,
+                                int is_float,
+                                size_t dim_fast,
+                                size_t dim_mid,
+                                size_t dim_slow,
+                                void** preview)
+{
+  const auto dims = mkit::dims_type{dim_fast, dim_mid, dim_slow};
+  switch (is_float) {
+    case 0:
+      return mkit::preview_pyramid(static_cast<const double*>(buf), dims, preview);
+    case 1:
+      return mkit::preview_pyramid(static_cast<const float*>(buf), dims, preview);
+    default:
+      return -1;
+  }
+}
+
+size_t C_API::mkit_preview_len(const void* preview)
+{
+  return mkit::retrieve_preview_len(preview);
+}
+
+const float* C_API::mkit_preview_level(const void* preview, int level, size_t* dims)
+{
+  auto d = mkit::dims_type{0, 0, 0};
+  const float* vals = mkit::retrieve_preview_level(preview, level, &d);
+  if (vals && dims)
+    std::copy(d.cbegin(), d.cend(), dims);
+  return vals;
+}
+
+int C_API::mkit_smart_log_ex(void* buf, int is_float, size_t buf_len, int options, void** meta)
+{
+  switch (is_float) {
+    case 0: {
+      double* bufd = static_cast<double*>(buf);
+      return mkit::smart_log(static_cast<const double*>(bufd), bufd, buf_len, meta,
+                             uint8_t(options));
+    }
+    case 1: {
+      float* buff = static_cast<float*>(buf);
+      return mkit::smart_log(static_cast<const float*>(buff), buff, buf_len, meta,
+                             uint8_t(options));
+    }
+    default:
+      return -1;
+  }
+}
+
+int C_API::mkit_slice_norm_ex(void* buf,
+                              int is_float,
+                              size_t dim_fast,
+                              size_t dim_mid,
+                              size_t dim_slow,
+                              int options,
+                              void** meta,
+                              void** preview)
+{
+  const auto dims = mkit::dims_type{dim_fast, dim_mid, dim_slow};
+  switch (is_float) {
+    case 0: {
+      double* bufd = static_cast<double*>(buf);
+      return mkit::slice_norm(static_cast<const double*>(bufd), bufd, dims, meta, preview,
+                              uint8_t(options));
+    }
+    case 1: {
+      float* buff = static_cast<float*>(buf);
+      return mkit::slice_norm(static_cast<const float*>(buff), buff, dims, meta, preview,
+                              uint8_t(options));
+    }
+    default:
+      return -1;
+  }
+}
+
+int C_API::mkit_block_index(const void* buf,
+                            int is_float,
+                            size_t dim_fast,
+                            size_t dim_mid,
+                            size_t dim_slow,
+                            const size_t* block,
+                            void** index)
+{
+  const auto dims = mkit::dims_type{dim_fast, dim_mid, dim_slow};
+  const auto blk = mkit::dims_type{block[0], block[1], block[2]};
+  switch (is_float) {
+    case 0:
+      return mkit::block_index(static_cast<const double*>(buf), dims, blk, index);
+    case 1:
+      return mkit::block_index(static_cast<const float*>(buf), dims, blk, index);
+    default:
+      return -1;
+  }
+}
+
+const void* C_API::mkit_log_block_index(const void* meta)
+{
+  return mkit::locate_log_block_index(meta);
+}
+
+const void* C_API::mkit_slice_norm_block_index(const void* meta,
+                                               size_t dim_fast,
+                                               size_t dim_mid,
+                                               size_t dim_slow)
+{
+  return mkit::locate_slice_norm_block_index(meta, {dim_fast, dim_mid, dim_slow});
+}
+
+size_t C_API::mkit_block_index_len(const void* index)
+{
+  return mkit::retrieve_block_index_len(index);
+}
+
+size_t C_API::mkit_num_blocks(const void* index)
+{
+  return mkit::retrieve_num_blocks(index);
+}
+
+void C_API::mkit_get_block_stats(const void* index, size_t idx, mkit_block_stats* stats)
+{
+  auto begin = mkit::dims_type{0, 0, 0}, end = mkit::dims_type{0, 0, 0};
+  const auto s = mkit::retrieve_block_stats(index, idx, &begin, &end);
+  stats->min = s.min;
+  stats->max = s.max;
+  stats->mean = s.mean;
+  stats->num_zero = s.num_zero;
+  std::copy(begin.cbegin(), begin.cend(), stats->begin);
+  std::copy(end.cbegin(), end.cend(), stats->end);
+}
+
+size_t C_API::mkit_query_blocks(const void* index,
+                                double lo,
+                                double hi,
+                                size_t* blocks,
+                                size_t max_blocks)
+{
+  const auto found = mkit::query_blocks(index, lo, hi);
+  if (blocks)
+    std::copy_n(found.cbegin(), std::min(found.size(), max_blocks), blocks);
+  return found.size();
+}
+
+void* C_API::mkit_sketch_create()
+{
+  return new mkit::Sketch();
+}
+
+void C_API::mkit_sketch_destroy(void* sketch)
+{
+  delete static_cast<mkit::Sketch*>(sketch);
+}
+
+int C_API::mkit_sketch_add(void* sketch, const void* buf, int is_float, size_t len)
+{
+  auto* sk = static_cast<mkit::Sketch*>(sketch);
+  switch (is_float) {
+    case 0:
+      sk->add(static_cast<const double*>(buf), len);
+      return 0;
+    case 1:
+      sk->add(static_cast<const float*>(buf), len);
+      return 0;
+    default:
+      return -1;
+  }
+}
+
+void C_API::mkit_sketch_merge(void* sketch, const void* other)
+{
+  static_cast<mkit::Sketch*>(sketch)->merge(*static_cast<const mkit::Sketch*>(other));
+}
+
+uint64_t C_API::mkit_sketch_count(const void* sketch)
+{
+  return static_cast<const mkit::Sketch*>(sketch)->count();
+}
+
+double C_API::mkit_sketch_quantile(const void* sketch, double q)
+{
+  return static_cast<const mkit::Sketch*>(sketch)->quantile(q);
+}
+
+size_t C_API::mkit_sketch_histogram(const void* sketch,
+                                    uint64_t* counts,
+                                    double* lower,
+                                    double* upper)
+{
+  const auto& hist = static_cast<const mkit::Sketch*>(sketch)->histogram();
+  for (size_t i = 0; i < hist.size(); i++) {
+    if (counts)
+      counts[i] = hist[i];
+    if (lower)
+      lower[i] = mkit::Sketch::bin_lower(i);
+    if (upper)
+      upper[i] = mkit::Sketch::bin_upper(i);
+  }
+  return hist.size();
+}
+
+int C_API::mkit_smart_log_sketch(void* buf,
+                                 int is_float,
+                                 size_t buf_len,
+                                 void** meta,
+                                 void* in_sketch,
+                                 void* out_sketch)
+{
+  auto* in_sk = static_cast<mkit::Sketch*>(in_sketch);
+  auto* out_sk = static_cast<mkit::Sketch*>(out_sketch);
+  switch (is_float) {
+    case 0: {
+      double* bufd = static_cast<double*>(buf);
+      return mkit::smart_log(static_cast<const double*>(bufd), bufd, buf_len, meta, 0, in_sk,
+                             out_sk);
+    }
+    case 1: {
+      float* buff = static_cast<float*>(buf);
+      return mkit::smart_log(static_cast<const float*>(buff), buff, buf_len, meta, 0, in_sk,
+                             out_sk);
+    }
+    default:
+      return -1;
+  }
+}
+
+int C_API::mkit_slice_norm_sketch(void* buf,
+                                  int is_float,
+                                  size_t dim_fast,
+                                  size_t dim_mid,
+                                  size_t dim_slow,
+                                  void** meta,
+                                  void* in_sketch,
+                                  void* out_sketch)
+{
+  const auto dims = mkit::dims_type{dim_fast, dim_mid, dim_slow};
+  auto* in_sk = static_cast<mkit::Sketch*>(in_sketch);
+  auto* out_sk = static_cast<mkit::Sketch*>(out_sketch);
+  switch (is_float) {
+    case 0: {
+      double* bufd = static_cast<double*>(buf);
+      return mkit::slice_norm(static_cast<const double*>(bufd), bufd, dims, meta, nullptr, 0,
+                              in_sk, out_sk);
+    }
+    case 1: {
+      float* buff = static_cast<float*>(buf);
+      return mkit::slice_norm(static_cast<const float*>(buff), buff, dims, meta, nullptr, 0,
+                              in_sk, out_sk);
+    }
+    default:
+      return -1;
+  }
+}
+
+int C_API::mkit_smart_asinh(void* buf, int is_float, size_t buf_len, void** meta)
+{
+  switch (is_float) {
+    case 0: {
+      double* bufd = static_cast<double*>(buf);
+      return mkit::smart_asinh(bufd, buf_len, meta);
+    }
+    case 1: {
+      float* buff = static_cast<float*>(buf);
+      return mkit::smart_asinh(buff, buf_len, meta);
+    }
+    default:
+      return -1;
+  }
+}
+
+int C_API::mkit_smart_sinh(void* buf, int is_float, size_t buf_len, const void* meta)
+{
+  switch (is_float) {
+    case 0: {
+      double* bufd = static_cast<double*>(buf);
+      return mkit::smart_sinh(bufd, buf_len, meta);
+    }
+    case 1: {
+      float* buff = static_cast<float*>(buf);
+      return mkit::smart_sinh(buff, buf_len, meta);
+    }
+    default:
+      return -1;
+  }
+}
+
+size_t C_API::mkit_asinh_meta_len(const void* meta)
+{
+  return mkit::retrieve_asinh_meta_len(meta);
+}
+
+int C_API::mkit_permute(const void* inbuf,
+                        int in_is_float,
+                        void* outbuf,
+                        int out_is_float,
+                        size_t dim_fast,
+                        size_t dim_mid,
+                        size_t dim_slow,
+                        int order,
+                        int stage,
+                        void** meta)
+{
+  if (out_is_float != 0 && out_is_float != 1)
+    return -1;
+
+  const auto dims = mkit::dims_type{dim_fast, dim_mid, dim_slow};
+  const auto o = uint8_t(order), s = uint8_t(stage);
+  switch (in_is_float * 2 + out_is_float) {
+    case 0:
+      return mkit::permute(static_cast<const double*>(inbuf), static_cast<double*>(outbuf), dims,
+                           o, s, meta);
+    case 1:
+      return mkit::permute(static_cast<const double*>(inbuf), static_cast<float*>(outbuf), dims,
+                           o, s, meta);
+    case 2:
+      return mkit::permute(static_cast<const float*>(inbuf), static_cast<double*>(outbuf), dims,
+                           o, s, meta);
+    case 3:
+      return mkit::permute(static_cast<const float*>(inbuf), static_cast<float*>(outbuf), dims,
+                           o, s, meta);
+    default:
+      return -1;
+  }
+}
+
+int C_API::mkit_inv_permute(const void* inbuf,
+                            int in_is_float,
+                            void* outbuf,
+                            int out_is_float,
+                            const void* meta)
+{
+  if (out_is_float != 0 && out_is_float != 1)
+    return -1;
+
+  switch (in_is_float * 2 + out_is_float) {
+    case 0:
+      return mkit::inv_permute(static_cast<const double*>(inbuf), static_cast<double*>(outbuf),
+                               meta);
+    case 1:
+      return mkit::inv_permute(static_cast<const double*>(inbuf), static_cast<float*>(outbuf),
+                               meta);
+    case 2:
+      return mkit::inv_permute(static_cast<const float*>(inbuf), static_cast<double*>(outbuf),
+                               meta);
+    case 3:
+      return mkit::inv_permute(static_cast<const float*>(inbuf), static_cast<float*>(outbuf),
+                               meta);
+    default:
+      return -1;
+  }
+}
+
+size_t C_API::mkit_permute_meta_len(const void* meta)
+{
+  return mkit::retrieve_permute_meta_len(meta);
+}
+
+int C_API::mkit_tile_norm(void* buf,
+                          int is_float,
+                          size_t dim_fast,
+                          size_t dim_mid,
+                          size_t dim_slow,
+                          size_t tile_fast,
+                          size_t tile_mid,
+                          size_t tile_slow,
+                          void** meta)
+{
+  const auto dims = mkit::dims_type{dim_fast, dim_mid, dim_slow};
+  const auto tile = mkit::dims_type{tile_fast, tile_mid, tile_slow};
+  switch (is_float) {
+    case 0: {
+      double* bufd = static_cast<double*>(buf);
+      return mkit::tile_norm(bufd, dims, tile, meta);
+    }
+    case 1: {
+      float* buff = static_cast<float*>(buf);
+      return mkit::tile_norm(buff, dims, tile, meta);
+    }
+    default:
+      return -1;
+  }
+}
+
+int C_API::mkit_inv_tile_norm(void* buf,
+                              int is_float,
+                              size_t dim_fast,
+                              size_t dim_mid,
+                              size_t dim_slow,
+                              const void* meta)
+{
+  const auto dims = mkit::dims_type{dim_fast, dim_mid, dim_slow};
+  switch (is_float) {
+    case 0: {
+      double* bufd = static_cast<double*>(buf);
+      return mkit::inv_tile_norm(bufd, dims, meta);
+    }
+    case 1: {
+      float* buff = static_cast<float*>(buf);
+      return mkit::inv_tile_norm(buff, dims, meta);
+    }
+    default:
+      return -1;
+  }
+}
+
+size_t C_API::mkit_tile_norm_meta_len(const void* meta)
+{
+  return mkit::retrieve_tile_norm_meta_len(meta);
+}
+
 int C_API::mkit_bitmask_zero(const void* inbuf,
                              int is_float,
                              size_t len,
@@ -117,3 +582,636 @@ size_t C_API::mkit_bitmask_zero_buf_len(const void* inbuf)
 {
   return mkit::retrieve_bitmask_zero_buf_len(inbuf);
 }
+
+int C_API::mkit_analyze(const void* buf, int is_float, size_t len, mkit_analysis* result)
+{
+  auto analysis = mkit::Analysis();
+  auto rtn = 0;
+  switch (is_float) {
+    case 0:
+      rtn = mkit::analyze(static_cast<const double*>(buf), len, &analysis);
+      break;
+    case 1:
+      rtn = mkit::analyze(static_cast<const float*>(buf), len, &analysis);
+      break;
+    default:
+      return -1;
+  }
+
+  result->min = analysis.min;
+  result->max = analysis.max;
+  result->num_neg = analysis.num_neg;
+  result->num_zero = analysis.num_zero;
+  result->num_near_zero = analysis.num_near_zero;
+  result->num_finite = analysis.num_finite;
+  result->num_nan = analysis.num_nan;
+  result->num_inf = analysis.num_inf;
+  result->log_meta_len = analysis.log_meta_len;
+  result->bitmask_zero_buf_len = analysis.bitmask_zero_buf_len;
+  result->byte_shuffle_buf_len = analysis.byte_shuffle_buf_len;
+  result->temporal_meta_len = analysis.temporal_meta_len;
+
+  return rtn;
+}
+
+int C_API::mkit_compare(const void* a,
+                        const void* b,
+                        int is_float,
+                        size_t len,
+                        double threshold,
+                        mkit_metrics* result)
+{
+  auto metrics = mkit::Metrics();
+  auto rtn = 0;
+  switch (is_float) {
+    case 0:
+      rtn = mkit::compare(static_cast<const double*>(a), static_cast<const double*>(b), len,
+                          threshold, &metrics);
+      break;
+    case 1:
+      rtn = mkit::compare(static_cast<const float*>(a), static_cast<const float*>(b), len,
+                          threshold, &metrics);
+      break;
+    default:
+      return -1;
+  }
+
+  result->max_abs_err = metrics.max_abs_err;
+  result->max_abs_idx = metrics.max_abs_idx;
+  result->max_rel_err = metrics.max_rel_err;
+  result->max_rel_idx = metrics.max_rel_idx;
+  result->rmse = metrics.rmse;
+  result->psnr = metrics.psnr;
+  result->bias = metrics.bias;
+  result->num_over_threshold = metrics.num_over_threshold;
+  result->num_compared = metrics.num_compared;
+  result->num_nonfinite_mismatch = metrics.num_nonfinite_mismatch;
+
+  return rtn;
+}
+
+int C_API::mkit_bitmask_zero_ex(const void* inbuf,
+                                int is_float,
+                                size_t len,
+                                int options,
+                                void** output)
+{
+  switch (is_float) {
+    case 0: {
+      const double* bufd = static_cast<const double*>(inbuf);
+      return mkit::bitmask_zero(bufd, len, output, uint8_t(options));
+    }
+    case 1: {
+      const float* buff = static_cast<const float*>(inbuf);
+      return mkit::bitmask_zero(buff, len, output, uint8_t(options));
+    }
+    default:
+      return -1;
+  }
+}
+
+int C_API::mkit_bitmask_value(const void* inbuf,
+                              int is_float,
+                              size_t len,
+                              const void* fills,
+                              size_t num_fills,
+                              int options,
+                              void** output)
+{
+  switch (is_float) {
+    case 0:
+      return mkit::bitmask_value(static_cast<const double*>(inbuf), len,
+                                 static_cast<const double*>(fills), num_fills, output,
+                                 uint8_t(options));
+    case 1:
+      return mkit::bitmask_value(static_cast<const float*>(inbuf), len,
+                                 static_cast<const float*>(fills), num_fills, output,
+                                 uint8_t(options));
+    default:
+      return -1;
+  }
+}
+
+int C_API::mkit_byte_shuffle(const void* inbuf,
+                             int is_float,
+                             size_t len,
+                             int flags,
+                             void** output)
+{
+  switch (is_float) {
+    case 0: {
+      const double* bufd = static_cast<const double*>(inbuf);
+      return mkit::byte_shuffle(bufd, len, uint8_t(flags), output);
+    }
+    case 1: {
+      const float* buff = static_cast<const float*>(inbuf);
+      return mkit::byte_shuffle(buff, len, uint8_t(flags), output);
+    }
+    default:
+      return -1;
+  }
+}
+
+int C_API::mkit_inv_byte_shuffle(const void* inbuf, void** output)
+{
+  return mkit::inv_byte_shuffle(inbuf, output);
+}
+
+size_t C_API::mkit_byte_shuffle_buf_len(const void* inbuf)
+{
+  return mkit::retrieve_byte_shuffle_buf_len(inbuf);
+}
+
+int C_API::mkit_smart_log_mixed(const void* inbuf,
+                                int in_is_float,
+                                void* outbuf,
+                                int out_is_float,
+                                size_t buf_len,
+                                void** meta)
+{
+  if (out_is_float != 0 && out_is_float != 1)
+    return -1;
+
+  switch (in_is_float * 2 + out_is_float) {
+    case 0:
+      return mkit::smart_log(static_cast<const double*>(inbuf), static_cast<double*>(outbuf),
+                             buf_len, meta);
+    case 1:
+      return mkit::smart_log(static_cast<const double*>(inbuf), static_cast<float*>(outbuf),
+                             buf_len, meta);
+    case 2:
+      return mkit::smart_log(static_cast<const float*>(inbuf), static_cast<double*>(outbuf),
+                             buf_len, meta);
+    case 3:
+      return mkit::smart_log(static_cast<const float*>(inbuf), static_cast<float*>(outbuf),
+                             buf_len, meta);
+    default:
+      return -1;
+  }
+}
+
+int C_API::mkit_smart_log_mixed_ex(const void* inbuf,
+                                   int in_is_float,
+                                   void* outbuf,
+                                   int out_is_float,
+                                   size_t buf_len,
+                                   int options,
+                                   void** meta)
+{
+  if (out_is_float != 0 && out_is_float != 1)
+    return -1;
+
+  switch (in_is_float * 2 + out_is_float) {
+    case 0:
+      return mkit::smart_log(static_cast<const double*>(inbuf), static_cast<double*>(outbuf),
+                             buf_len, meta, uint8_t(options));
+    case 1:
+      return mkit::smart_log(static_cast<const double*>(inbuf), static_cast<float*>(outbuf),
+                             buf_len, meta, uint8_t(options));
+    case 2:
+      return mkit::smart_log(static_cast<const float*>(inbuf), static_cast<double*>(outbuf),
+                             buf_len, meta, uint8_t(options));
+    case 3:
+      return mkit::smart_log(static_cast<const float*>(inbuf), static_cast<float*>(outbuf),
+                             buf_len, meta, uint8_t(options));
+    default:
+      return -1;
+  }
+}
+
+int C_API::mkit_smart_exp_mixed(const void* inbuf,
+                                int in_is_float,
+                                void* outbuf,
+                                int out_is_float,
+                                size_t buf_len,
+                                const void* meta)
+{
+  if (out_is_float != 0 && out_is_float != 1)
+    return -1;
+
+  switch (in_is_float * 2 + out_is_float) {
+    case 0:
+      return mkit::smart_exp(static_cast<const double*>(inbuf), static_cast<double*>(outbuf),
+                             buf_len, meta);
+    case 1:
+      return mkit::smart_exp(static_cast<const double*>(inbuf), static_cast<float*>(outbuf),
+                             buf_len, meta);
+    case 2:
+      return mkit::smart_exp(static_cast<const float*>(inbuf), static_cast<double*>(outbuf),
+                             buf_len, meta);
+    case 3:
+      return mkit::smart_exp(static_cast<const float*>(inbuf), static_cast<float*>(outbuf),
+                             buf_len, meta);
+    default:
+      return -1;
+  }
+}
+
+int C_API::mkit_slice_norm_mixed(const void* inbuf,
+                                 int in_is_float,
+                                 void* outbuf,
+                                 int out_is_float,
+                                 size_t dim_fast,
+                                 size_t dim_mid,
+                                 size_t dim_slow,
+                                 void** meta)
+{
+  if (out_is_float != 0 && out_is_float != 1)
+    return -1;
+
+  const auto dims = mkit::dims_type{dim_fast, dim_mid, dim_slow};
+  switch (in_is_float * 2 + out_is_float) {
+    case 0:
+      return mkit::slice_norm(static_cast<const double*>(inbuf), static_cast<double*>(outbuf),
+                              dims, meta);
+    case 1:
+      return mkit::slice_norm(static_cast<const double*>(inbuf), static_cast<float*>(outbuf),
+                              dims, meta);
+    case 2:
+      return mkit::slice_norm(static_cast<const float*>(inbuf), static_cast<double*>(outbuf),
+                              dims, meta);
+    case 3:
+      return mkit::slice_norm(static_cast<const float*>(inbuf), static_cast<float*>(outbuf),
+                              dims, meta);
+    default:
+      return -1;
+  }
+}
+
+int C_API::mkit_inv_slice_norm_mixed(const void* inbuf,
+                                     int in_is_float,
+                                     void* outbuf,
+                                     int out_is_float,
+                                     size_t dim_fast,
+                                     size_t dim_mid,
+                                     size_t dim_slow,
+                                     const void* meta)
+{
+  if (out_is_float != 0 && out_is_float != 1)
+    return -1;
+
+  const auto dims = mkit::dims_type{dim_fast, dim_mid, dim_slow};
+  switch (in_is_float * 2 + out_is_float) {
+    case 0:
+      return mkit::inv_slice_norm(static_cast<const double*>(inbuf),
+                                  static_cast<double*>(outbuf), dims, meta);
+    case 1:
+      return mkit::inv_slice_norm(static_cast<const double*>(inbuf),
+                                  static_cast<float*>(outbuf), dims, meta);
+    case 2:
+      return mkit::inv_slice_norm(static_cast<const float*>(inbuf),
+                                  static_cast<double*>(outbuf), dims, meta);
+    case 3:
+      return mkit::inv_slice_norm(static_cast<const float*>(inbuf),
+                                  static_cast<float*>(outbuf), dims, meta);
+    default:
+      return -1;
+  }
+}
+
+int C_API::mkit_temporal_delta(void* buf,
+                               int is_float,
+                               size_t buf_len,
+                               const char* field,
+                               int mode,
+                               uint32_t keyframe_interval,
+                               void** meta)
+{
+  switch (is_float) {
+    case 0: {
+      double* bufd = static_cast<double*>(buf);
+      return mkit::temporal_delta(bufd, buf_len, field, uint8_t(mode), keyframe_interval, meta);
+    }
+    case 1: {
+      float* buff = static_cast<float*>(buf);
+      return mkit::temporal_delta(buff, buf_len, field, uint8_t(mode), keyframe_interval, meta);
+    }
+    default:
+      return -1;
+  }
+}
+
+int C_API::mkit_set_temporal_reference(const void* buf,
+                                       int is_float,
+                                       size_t buf_len,
+                                       const char* field,
+                                       const void* meta)
+{
+  switch (is_float) {
+    case 0: {
+      const double* bufd = static_cast<const double*>(buf);
+      return mkit::set_temporal_reference(bufd, buf_len, field, meta);
+    }
+    case 1: {
+      const float* buff = static_cast<const float*>(buf);
+      return mkit::set_temporal_reference(buff, buf_len, field, meta);
+    }
+    default:
+      return -1;
+  }
+}
+
+int C_API::mkit_inv_temporal_delta(void* buf,
+                                   int is_float,
+                                   size_t buf_len,
+                                   const char* field,
+                                   const void* meta)
+{
+  switch (is_float) {
+    case 0: {
+      double* bufd = static_cast<double*>(buf);
+      return mkit::inv_temporal_delta(bufd, buf_len, field, meta);
+    }
+    case 1: {
+      float* buff = static_cast<float*>(buf);
+      return mkit::inv_temporal_delta(buff, buf_len, field, meta);
+    }
+    default:
+      return -1;
+  }
+}
+
+size_t C_API::mkit_temporal_meta_len(const void* meta)
+{
+  return mkit::retrieve_temporal_meta_len(meta);
+}
+
+void C_API::mkit_clear_temporal_cache(const char* field)
+{
+  mkit::clear_temporal_cache(field);
+}
+
+void* C_API::mkit_mask_store_create()
+{
+  return new mkit::MaskStore();
+}
+
+void C_API::mkit_mask_store_destroy(void* store)
+{
+  delete static_cast<mkit::MaskStore*>(store);
+}
+
+int C_API::mkit_mask_store_add(void* store,
+                               const void* buf,
+                               size_t len,
+                               size_t mask_begin,
+                               size_t mask_end,
+                               size_t* id)
+{
+  return static_cast<mkit::MaskStore*>(store)->add(buf, len, mask_begin, mask_end, id);
+}
+
+int C_API::mkit_mask_store_add_log_meta(void* store, const void* meta, size_t* id)
+{
+  return static_cast<mkit::MaskStore*>(store)->add_log_meta(meta, id);
+}
+
+int C_API::mkit_mask_store_add_bitmask_zero(void* store, const void* output, size_t* id)
+{
+  return static_cast<mkit::MaskStore*>(store)->add_bitmask_zero(output, id);
+}
+
+int C_API::mkit_mask_store_serialize(const void* store, void** buf, size_t* len)
+{
+  if (*buf != nullptr)
+    return 1;
+  const auto out = static_cast<const mkit::MaskStore*>(store)->serialize();
+  *buf = std::malloc(out.size());
+  std::memcpy(*buf, out.data(), out.size());
+  *len = out.size();
+  return 0;
+}
+
+size_t C_API::mkit_mask_store_buffer_len(const void* buf, size_t id)
+{
+  return mkit::MaskStoreView(buf).buffer_len(id);
+}
+
+int C_API::mkit_mask_store_retrieve(const void* buf, size_t id, void* dst)
+{
+  return mkit::MaskStoreView(buf).retrieve(id, dst);
+}
+
+void* C_API::mkit_container_create(const char* filename)
+{
+  auto* writer = new mkit::ContainerWriter();
+  if (writer->open(filename)) {
+    delete writer;
+    return nullptr;
+  }
+  return writer;
+}
+
+int C_API::mkit_container_add_field(void* writer,
+                                    const char* name,
+                                    int is_float,
+                                    size_t dim_fast,
+                                    size_t dim_mid,
+                                    size_t dim_slow,
+                                    const uint8_t* ops,
+                                    size_t num_ops,
+                                    const void* payload,
+                                    size_t payload_len,
+                                    const void* meta,
+                                    size_t meta_len)
+{
+  auto op_vec = std::vector<mkit::Op>(num_ops);
+  for (size_t i = 0; i < num_ops; i++)
+    op_vec[i] = mkit::Op{ops[i]};
+  auto* w = static_cast<mkit::ContainerWriter*>(writer);
+  return w->add_field(name, is_float, {dim_fast, dim_mid, dim_slow}, op_vec, payload,
+                      payload_len, meta, meta_len);
+}
+
+int C_API::mkit_container_finish(void* writer)
+{
+  auto* w = static_cast<mkit::ContainerWriter*>(writer);
+  auto rtn = w->finish();
+  delete w;
+  return rtn;
+}
+
+void* C_API::mkit_container_open(const char* filename)
+{
+  auto* reader = new mkit::ContainerReader();
+  if (reader->open(filename)) {
+    delete reader;
+    return nullptr;
+  }
+  return reader;
+}
+
+int C_API::mkit_container_find_field(const void* reader,
+                                     const char* name,
+                                     int* is_float,
+                                     size_t* dims,
+                                     uint8_t* ops,
+                                     size_t* num_ops,
+                                     const void** payload,
+                                     size_t* payload_len,
+                                     const void** meta,
+                                     size_t* meta_len)
+{
+  const auto* r = static_cast<const mkit::ContainerReader*>(reader);
+  const auto* info = r->find(name);
+  if (!info)
+    return 1;
+
+  *is_float = info->is_float;
+  std::copy(info->dims.cbegin(), info->dims.cend(), dims);
+  if (ops) {
+    for (size_t i = 0; i < info->ops.size(); i++)
+      ops[i] = uint8_t(info->ops[i]);
+  }
+  *num_ops = info->ops.size();
+  *payload = info->payload;
+  *payload_len = info->payload_len;
+  *meta = info->meta;
+  *meta_len = info->meta_len;
+
+  return 0;
+}
+
+void C_API::mkit_container_close(void* reader)
+{
+  delete static_cast<mkit::ContainerReader*>(reader);
+}
+
+//
+// Asynchronous operations: a handle is a heap-allocated std::future<int>.
+//
+void* C_API::mkit_smart_log_async(void* buf,
+                                  int is_float,
+                                  size_t buf_len,
+                                  void** meta,
+                                  mkit_callback callback,
+                                  void* user_data)
+{
+  switch (is_float) {
+    case 0:
+      return new std::future<int>(
+          mkit::smart_log_async(static_cast<double*>(buf), buf_len, meta, callback, user_data));
+    case 1:
+      return new std::future<int>(
+          mkit::smart_log_async(static_cast<float*>(buf), buf_len, meta, callback, user_data));
+    default:
+      return nullptr;
+  }
+}
+
+void* C_API::mkit_smart_exp_async(void* buf,
+                                  int is_float,
+                                  size_t buf_len,
+                                  const void* meta,
+                                  mkit_callback callback,
+                                  void* user_data)
+{
+  switch (is_float) {
+    case 0:
+      return new std::future<int>(
+          mkit::smart_exp_async(static_cast<double*>(buf), buf_len, meta, callback, user_data));
+    case 1:
+      return new std::future<int>(
+          mkit::smart_exp_async(static_cast<float*>(buf), buf_len, meta, callback, user_data));
+    default:
+      return nullptr;
+  }
+}
+
+void* C_API::mkit_slice_norm_async(void* buf,
+                                   int is_float,
+                                   size_t dim_fast,
+                                   size_t dim_mid,
+                                   size_t dim_slow,
+                                   void** meta,
+                                   mkit_callback callback,
+                                   void* user_data)
+{
+  const auto dims = mkit::dims_type{dim_fast, dim_mid, dim_slow};
+  switch (is_float) {
+    case 0:
+      return new std::future<int>(
+          mkit::slice_norm_async(static_cast<double*>(buf), dims, meta, callback, user_data));
+    case 1:
+      return new std::future<int>(
+          mkit::slice_norm_async(static_cast<float*>(buf), dims, meta, callback, user_data));
+    default:
+      return nullptr;
+  }
+}
+
+void* C_API::mkit_inv_slice_norm_async(void* buf,
+                                       int is_float,
+                                       size_t dim_fast,
+                                       size_t dim_mid,
+                                       size_t dim_slow,
+                                       const void* meta,
+                                       mkit_callback callback,
+                                       void* user_data)
+{
+  const auto dims = mkit::dims_type{dim_fast, dim_mid, dim_slow};
+  switch (is_float) {
+    case 0:
+      return new std::future<int>(mkit::inv_slice_norm_async(static_cast<double*>(buf), dims,
+                                                             meta, callback, user_data));
+    case 1:
+      return new std::future<int>(mkit::inv_slice_norm_async(static_cast<float*>(buf), dims,
+                                                             meta, callback, user_data));
+    default:
+      return nullptr;
+  }
+}
+
+int C_API::mkit_async_poll(const void* handle)
+{
+  const auto* f = static_cast<const std::future<int>*>(handle);
+  return f->wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+int C_API::mkit_async_wait(void* handle)
+{
+  auto* f = static_cast<std::future<int>*>(handle);
+  auto rtn = int{-1};  // The operation or the callback threw, e.g., ran out of memory.
+  try {
+    rtn = f->get();
+  }
+  catch (...) {
+  }
+  delete f;
+  return rtn;
+}
+
+int C_API::mkit_set_async_limits(size_t max_tasks, size_t threads_per_task)
+{
+  return mkit::set_async_limits(max_tasks, threads_per_task);
+}
+
+int C_API::mkit_tune(size_t max_len)
+{
+  return mkit::tune(max_len);
+}
+
+int C_API::mkit_save_tune_profile(const char* filename)
+{
+  return mkit::save_tune_profile(filename);
+}
+
+int C_API::mkit_load_tune_profile(const char* filename)
+{
+  return mkit::load_tune_profile(filename);
+}
+
+size_t C_API::mkit_tune_class_len(size_t size_class)
+{
+  return mkit::tune_class_len(size_class);
+}
+
+int C_API::mkit_tuned_params(int op, size_t len, size_t* stride, int* num_threads)
+{
+  if (op < 0 || op >= int(mkit::tune_num_ops))
+    return 1;
+  const auto p = mkit::tuned_params(uint8_t(op), len);
+  *stride = p.stride;
+  *num_threads = p.num_threads;
+  return 0;
+}
@@ -0,0 +1,264 @@
+#include "MaskStore.h"
+#include "MURaMKit.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr size_t header_len = sizeof(uint64_t) * 4;
+
+auto pad8(size_t len) -> size_t
+{
+  return (len + 7) / 8 * 8;
+}
+
+auto read64(const uint8_t* p) -> uint64_t
+{
+  uint64_t v = 0;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+// A 64-bit hash of a block: every word is mixed with a multiply and a rotation, and the
+//    result goes through the finalizer of MurmurHash3.
+auto hash_block(const uint8_t* p) -> uint64_t
+{
+  uint64_t h = 0x9E3779B97F4A7C15ull;
+  for (size_t i = 0; i < mkit::MaskStore::block_len; i += 8) {
+    h ^= read64(p + i) * 0xC2B2AE3D27D4EB4Full;
+    h = ((h << 31) | (h >> 33)) * 0x9E3779B97F4A7C15ull;
+  }
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDull;
+  h ^= h >> 33;
+  h *= 0xC4CEB9FE1A85EC53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+};  // namespace
+
+auto mkit::MaskStore::add(const void* buf,
+                          size_t len,
+                          size_t mask_begin,
+                          size_t mask_end,
+                          size_t* id) -> int
+{
+  if (mask_begin > mask_end || mask_end > len)
+    return 1;
+
+  const uint8_t* const p = static_cast<const uint8_t*>(buf);
+  const size_t mask_len = mask_end - mask_begin;
+  const size_t num_blocks = (mask_len + block_len - 1) / block_len;
+
+  // Copy the blocks out, with the last one padded, and hash them in parallel.
+  auto blocks = std::vector<uint8_t>(num_blocks * block_len, 0);
+  auto hashes = std::vector<uint64_t>(num_blocks);
+#pragma omp parallel for
+  for (size_t b = 0; b < num_blocks; b++) {
+    const size_t begin = b * block_len;
+    std::memcpy(blocks.data() + begin, p + mask_begin + begin,
+                std::min(block_len, mask_len - begin));
+    hashes[b] = hash_block(blocks.data() + begin);
+  }
+
+  auto rec = Record();
+  rec.len = len;
+  rec.mask_begin = mask_begin;
+  rec.mask_end = mask_end;
+  rec.rest.reserve(len - mask_len);
+  rec.rest.insert(rec.rest.end(), p, p + mask_begin);
+  rec.rest.insert(rec.rest.end(), p + mask_end, p + len);
+  rec.refs.resize(num_blocks);
+
+  for (size_t b = 0; b < num_blocks; b++) {
+    const uint8_t* blk = blocks.data() + b * block_len;
+    const auto [first, last] = m_index.equal_range(hashes[b]);
+    auto match = std::find_if(first, last, [&](const auto& kv) {
+      return std::memcmp(m_blocks.data() + kv.second * block_len, blk, block_len) == 0;
+    });
+    if (match != last)
+      rec.refs[b] = match->second;
+    else {
+      const uint64_t n = m_blocks.size() / block_len;
+      m_blocks.insert(m_blocks.end(), blk, blk + block_len);
+      m_index.emplace(hashes[b], n);
+      rec.refs[b] = n;
+    }
+  }
+
+  m_num_refs += num_blocks;
+  m_records.push_back(std::move(rec));
+  *id = m_records.size() - 1;
+  return 0;
+}
+
+auto mkit::MaskStore::add_log_meta(const void* meta, size_t* id) -> int
+{
+  // The masks (or the ternary states) follow the length and treatment fields.
+  const uint8_t* const p = static_cast<const uint8_t*>(meta);
+  const auto buf_len = read64(p);
+  auto [has_neg, has_zero, ternary, b3, b4, b5, b6, b7] = unpack_8_booleans(p[8]);
+  const size_t mask_num_bytes = (buf_len + 63) / 64 * 8;
+  const size_t region = ternary ? (buf_len + 4) / 5 : mask_num_bytes * (has_neg + has_zero);
+  return add(meta, retrieve_log_meta_len(meta), 9, 9 + region, id);
+}
+
+auto mkit::MaskStore::add_bitmask_zero(const void* output, size_t* id) -> int
+{
+  // The mask follows the header, and the fill values when there are any. An adaptively
+  //    coded mask is no plain bitmask, so it could neither be read by read_long() nor be
+  //    deduplicated across buffers.
+  const uint8_t* const p = static_cast<const uint8_t*>(output);
+  if (p[0] & BZ_ADAPTIVE)
+    return 1;
+  const size_t width = (p[0] & 1) ? sizeof(float) : sizeof(double);
+  const size_t num_vals = read64(p + 1);
+  const size_t begin = (p[0] & BZ_VALUE_LIST) ? 17 + 1 + p[17] * width : 17;
+  const size_t end = begin + (num_vals + 63) / 64 * 8;
+  return add(output, retrieve_bitmask_zero_buf_len(output), begin, end, id);
+}
+
+auto mkit::MaskStore::num_buffers() const -> size_t
+{
+  return m_records.size();
+}
+
+auto mkit::MaskStore::num_blocks() const -> size_t
+{
+  return m_num_refs;
+}
+
+auto mkit::MaskStore::num_unique_blocks() const -> size_t
+{
+  return m_blocks.size() / block_len;
+}
+
+auto mkit::MaskStore::serialize() const -> std::vector<uint8_t>
+{
+  const size_t num_buffers = m_records.size();
+  auto offsets = std::vector<uint64_t>(num_buffers);
+  size_t pos = header_len + sizeof(uint64_t) * num_buffers + m_blocks.size();
+  for (size_t i = 0; i < num_buffers; i++) {
+    offsets[i] = pos;
+    const auto& r = m_records[i];
+    pos += sizeof(uint64_t) * (3 + r.refs.size()) + pad8(r.rest.size());
+  }
+
+  auto out = std::vector<uint8_t>(pos, 0);
+  const uint64_t header[4] = {pos, num_buffers, num_unique_blocks(), block_len};
+  std::memcpy(out.data(), header, sizeof(header));
+  std::memcpy(out.data() + header_len, offsets.data(), sizeof(uint64_t) * num_buffers);
+  std::memcpy(out.data() + header_len + sizeof(uint64_t) * num_buffers, m_blocks.data(),
+              m_blocks.size());
+
+#pragma omp parallel for
+  for (size_t i = 0; i < num_buffers; i++) {
+    const auto& r = m_records[i];
+    uint8_t* dst = out.data() + offsets[i];
+    const uint64_t fields[3] = {r.len, r.mask_begin, r.mask_end};
+    std::memcpy(dst, fields, sizeof(fields));
+    std::memcpy(dst + sizeof(fields), r.refs.data(), sizeof(uint64_t) * r.refs.size());
+    std::memcpy(dst + sizeof(fields) + sizeof(uint64_t) * r.refs.size(), r.rest.data(),
+                r.rest.size());
+  }
+
+  return out;
+}
+
+//
+// MaskStoreView functions
+//
+mkit::MaskStoreView::MaskStoreView(const void* store)
+    : m_ptr(static_cast<const uint8_t*>(store))
+{
+  m_num_buffers = read64(m_ptr + sizeof(uint64_t));
+  m_block_len = read64(m_ptr + sizeof(uint64_t) * 3);
+  m_blocks = m_ptr + header_len + sizeof(uint64_t) * m_num_buffers;
+}
+
+auto mkit::MaskStoreView::entry(size_t id) const -> Entry
+{
+  const uint8_t* p = m_ptr + read64(m_ptr + header_len + sizeof(uint64_t) * id);
+  auto e = Entry();
+  e.len = read64(p);
+  e.mask_begin = read64(p + 8);
+  e.mask_end = read64(p + 16);
+  e.refs = p + 24;
+  const size_t num_blocks = (e.mask_end - e.mask_begin + m_block_len - 1) / m_block_len;
+  e.rest = e.refs + sizeof(uint64_t) * num_blocks;
+  return e;
+}
+
+auto mkit::MaskStoreView::num_buffers() const -> size_t
+{
+  return m_num_buffers;
+}
+
+auto mkit::MaskStoreView::buffer_len(size_t id) const -> size_t
+{
+  return (id < m_num_buffers) ? entry(id).len : 0;
+}
+
+auto mkit::MaskStoreView::retrieve(size_t id, void* dst) const -> int
+{
+  if (id >= m_num_buffers)
+    return 1;
+
+  const auto e = entry(id);
+  uint8_t* const out = static_cast<uint8_t*>(dst);
+  const size_t mask_len = e.mask_end - e.mask_begin;
+  const size_t num_blocks = (mask_len + m_block_len - 1) / m_block_len;
+  std::memcpy(out, e.rest, e.mask_begin);
+  std::memcpy(out + e.mask_end, e.rest + e.mask_begin, e.len - e.mask_end);
+
+#pragma omp parallel for
+  for (size_t b = 0; b < num_blocks; b++) {
+    const size_t begin = b * m_block_len;
+    const uint8_t* blk = m_blocks + read64(e.refs + sizeof(uint64_t) * b) * m_block_len;
+    std::memcpy(out + e.mask_begin + begin, blk, std::min(m_block_len, mask_len - begin));
+  }
+
+  return 0;
+}
+
+auto mkit::MaskStoreView::read_long(size_t id, size_t idx) const -> uint64_t
+{
+  const auto e = entry(id);
+  return bitmask(id, 0, (e.mask_end - e.mask_begin) * 8).read_long(idx);
+}
+
+auto mkit::MaskStoreView::bitmask(size_t id, size_t offset, size_t num_bits) const
+    -> MaskStoreBitmask
+{
+  auto m = MaskStoreBitmask();
+  m.m_blocks = m_blocks;
+  m.m_refs = entry(id).refs;
+  m.m_block_len = m_block_len;
+  m.m_offset = offset;
+  m.m_num_bits = num_bits;
+  return m;
+}
+
+//
+// MaskStoreBitmask functions
+//
+auto mkit::MaskStoreBitmask::size() const -> size_t
+{
+  return m_num_bits;
+}
+
+auto mkit::MaskStoreBitmask::read_long(size_t idx) const -> uint64_t
+{
+  // Blocks hold a whole number of words, so a word never spans two blocks.
+  const size_t pos = m_offset + idx / 64 * 8;
+  const uint8_t* blk = m_blocks + read64(m_refs + sizeof(uint64_t) * (pos / m_block_len)) *
+                                      m_block_len;
+  return read64(blk + pos % m_block_len);
+}
+
+auto mkit::MaskStoreBitmask::read_bit(size_t idx) const -> bool
+{
+  return (read_long(idx) >> (idx % 64)) & 1;
+}
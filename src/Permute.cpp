@@ -0,0 +1,366 @@
+#include "BitmaskView.h"
+#include "MURaMKit.h"
+#include "Reduction.h"
+#include <omp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+// Meta data definition:
+// meta_len (uint64_t) + original dims (3 x uint64_t) + order (uint8_t) + stage (uint8_t) +
+//   reserved (6 bytes) + meta data of the stage, which is exactly what smart_log() or
+//   slice_norm() would produce on the permuted data
+//
+constexpr size_t header_len = sizeof(uint64_t) * 4 + 8;
+
+// For each order, which axis of the input becomes each axis (fastest first) of the output.
+constexpr size_t axes[6][3] = {{0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}};
+
+// Dimensions of a tile of the output. A tile touches at most tile[0] x tile[2] cache lines
+//    of the input when the fastest output axis is a slow input axis, which fit in L1.
+constexpr size_t tile[3] = {32, 32, 8};
+
+// Copy `in` to `out` with permuted axes: axis `a` of `out` is axis `src_axis[a]` of `in`.
+//    Every output value is produced by `func(value, input_idx, output_idx)`, so that a
+//    conditioning stage is applied while a tile is in cache.
+template <typename T1, typename T2, typename Func>
+void permute_tiles(const T1* in,
+                   mkit::dims_type in_dims,
+                   const size_t* src_axis,
+                   T2* out,
+                   Func&& func)
+{
+  const size_t in_strides[3] = {1, in_dims[0], in_dims[0] * in_dims[1]};
+  const size_t od[3] = {in_dims[src_axis[0]], in_dims[src_axis[1]], in_dims[src_axis[2]]};
+  const size_t s[3] = {in_strides[src_axis[0]], in_strides[src_axis[1]],
+                       in_strides[src_axis[2]]};
+  const size_t nt[3] = {(od[0] + tile[0] - 1) / tile[0], (od[1] + tile[1] - 1) / tile[1],
+                        (od[2] + tile[2] - 1) / tile[2]};
+
+#pragma omp parallel for collapse(3)
+  for (size_t tz = 0; tz < nt[2]; tz++)
+    for (size_t ty = 0; ty < nt[1]; ty++)
+      for (size_t tx = 0; tx < nt[0]; tx++) {
+        const size_t x_end = std::min(od[0], (tx + 1) * tile[0]);
+        for (size_t z = tz * tile[2]; z < std::min(od[2], (tz + 1) * tile[2]); z++)
+          for (size_t y = ty * tile[1]; y < std::min(od[1], (ty + 1) * tile[1]); y++) {
+            const size_t o = (z * od[1] + y) * od[0];
+            const size_t i = z * s[2] + y * s[1];
+            for (size_t x = tx * tile[0]; x < x_end; x++)
+              out[o + x] = func(in[i + x * s[0]], i + x * s[0], o + x);
+          }
+      }
+}
+
+// Sum values of `in` along every axis but `axis`, applying `func` on each value first.
+//    The result has `dims[axis]` values. Tasks work on tiles of rows, so that all threads
+//    stay busy even when dims[2] is small.
+template <typename T, typename Func>
+auto sum_along(const T* in, mkit::dims_type dims, size_t axis, Func&& func) -> std::vector<double>
+{
+  const size_t len = dims[axis];
+  const int num_threads = omp_get_max_threads();
+  auto partials = mkit::Partials(num_threads, len);
+  const auto tiles = mkit::Tiles(dims, 1, 1, num_threads);
+
+#pragma omp parallel num_threads(num_threads)
+  {
+#pragma omp for schedule(static, 1)
+    for (size_t r = 0; r < partials.num_rows(); r++)
+      partials.clear(r);
+
+    double* const mybuf = partials.row(omp_get_thread_num());
+#pragma omp for
+    for (size_t t = 0; t < tiles.count(); t++) {
+      const size_t z = t / tiles.num_y;
+      const size_t y_begin = t % tiles.num_y * tiles.y_tile;
+      for (size_t y = y_begin; y < std::min(dims[1], y_begin + tiles.y_tile); y++) {
+        const T* row = in + (z * dims[1] + y) * dims[0];
+        if (axis == 0) {
+          for (size_t x = 0; x < dims[0]; x++)
+            mybuf[x] += func(row[x], x);
+        }
+        else {
+          const size_t c = (axis == 1) ? y : z;
+          double sum = 0.0;
+          for (size_t x = 0; x < dims[0]; x++)
+            sum += func(row[x], c);
+          mybuf[c] += sum;
+        }
+      }
+    }
+  }
+
+  auto sums = std::vector<double>(len);
+  partials.merge(sums.data(), num_threads);
+  return sums;
+}
+
+void pack_log_states(const uint8_t* states, size_t len, uint8_t treatment, uint8_t* dst)
+{
+  auto [has_neg, has_zero, ternary, b3, b4, b5, b6, b7] = mkit::unpack_8_booleans(treatment);
+
+  if (ternary) {
+    const size_t num_groups = (len + 4) / 5;
+#pragma omp parallel for
+    for (size_t g = 0; g < num_groups; g++) {
+      uint8_t code = 0, weight = 1;
+      for (size_t i = g * 5; i < std::min(len, g * 5 + 5); i++) {
+        code += states[i] * weight;
+        weight *= 3;
+      }
+      dst[g] = code;
+    }
+    return;
+  }
+
+  // The sign mask has bits of non-negative values set, and the zero mask has bits of zeros
+  //    set, the same as the masks of smart_log().
+  const size_t num_words = (len + 63) / 64;
+  uint8_t* const sign_dst = dst;
+  uint8_t* const zero_dst = dst + (has_neg ? num_words * 8 : 0);
+#pragma omp parallel for
+  for (size_t w = 0; w < num_words; w++) {
+    uint64_t signs = ~uint64_t{0}, zeros = 0;
+    for (size_t i = w * 64; i < std::min(len, w * 64 + 64); i++) {
+      const auto bit = uint64_t{1} << (i % 64);
+      if (states[i] == mkit::log_state_neg)
+        signs &= ~bit;
+      else if (states[i] == mkit::log_state_zero)
+        zeros |= bit;
+    }
+    if (has_neg)
+      std::memcpy(sign_dst + w * 8, &signs, 8);
+    if (has_zero)
+      std::memcpy(zero_dst + w * 8, &zeros, 8);
+  }
+}
+
+};  // namespace
+
+auto mkit::permuted_dims(dims_type dims, uint8_t order) -> dims_type
+{
+  const auto* a = axes[order % 6];
+  return {dims[a[0]], dims[a[1]], dims[a[2]]};
+}
+
+template <typename T1, typename T2>
+auto mkit::permute(const T1* input,
+                   T2* output,
+                   dims_type dims,
+                   uint8_t order,
+                   uint8_t stage,
+                   void** meta) -> int
+{
+  if (*meta != nullptr || order > PERMUTE_ZYX || stage > PERMUTE_STAGE_NORM)
+    return 1;
+  if (static_cast<const void*>(input) == static_cast<const void*>(output) &&
+      order != PERMUTE_XYZ)
+    return 1;
+
+  using calc_type = std::common_type_t<T1, T2>;
+  const size_t total_vals = dims[0] * dims[1] * dims[2];
+  const auto od = permuted_dims(dims, order);
+  const size_t* const src_axis = axes[order];
+
+  auto write_header = [&](size_t stage_len) -> uint8_t* {
+    const uint64_t meta_len = header_len + stage_len;
+    uint8_t* buf = static_cast<uint8_t*>(std::malloc(meta_len));
+    std::memcpy(buf, &meta_len, sizeof(meta_len));
+    for (size_t i = 0; i < 3; i++) {
+      const auto d = uint64_t{dims[i]};
+      std::memcpy(buf + sizeof(uint64_t) * (i + 1), &d, sizeof(d));
+    }
+    std::memset(buf + sizeof(uint64_t) * 4, 0, 8);
+    buf[sizeof(uint64_t) * 4] = order;
+    buf[sizeof(uint64_t) * 4 + 1] = stage;
+    return buf;
+  };
+
+  if (stage == PERMUTE_STAGE_NONE) {
+    *meta = write_header(0);
+    permute_tiles(input, dims, src_axis, output, [](auto v, size_t, size_t) { return T2(v); });
+    return 0;
+  }
+
+  if (stage == PERMUTE_STAGE_LOG) {
+    // States of values are recorded in the output order one byte each, and packed afterwards,
+    //    because tiles of the output do not line up with bytes or words of the packed states.
+    //    The input is only read by the tile pass; the buffer is filled by it, too.
+    auto states = std::make_unique_for_overwrite<uint8_t[]>(total_vals);
+    permute_tiles(input, dims, src_axis, output, [&](auto in, size_t, size_t o) {
+      auto v = calc_type(in);
+      uint8_t state = log_state_pos;
+      if (v < 0.0) {
+        state = log_state_neg;
+        v = -v;
+      }
+      if (v == 0.0)
+        state = log_state_zero;
+      else
+        v = std::log(v);
+      states[o] = state;
+      return T2(v);
+    });
+
+    // The same decisions as smart_log(), which do not depend on the order of values, made
+    //    from the recorded states.
+    auto has_neg = false, has_zero = false;
+#pragma omp parallel for reduction(|| : has_neg, has_zero)
+    for (size_t i = 0; i < total_vals; i++) {
+      has_neg = has_neg || states[i] == log_state_neg;
+      has_zero = has_zero || states[i] == log_state_zero;
+    }
+    const auto ternary = has_neg && has_zero;
+    const auto treatment =
+        pack_8_booleans({has_neg, has_zero, ternary, false, false, false, false, false});
+    const size_t log_len = calc_log_meta_len(total_vals, treatment);
+
+    uint8_t* buf = write_header(log_len);
+    const auto tmp64 = uint64_t{total_vals};
+    std::memcpy(buf + header_len, &tmp64, sizeof(tmp64));
+    buf[header_len + 8] = treatment;
+    if (has_neg || has_zero)
+      pack_log_states(states.get(), total_vals, treatment, buf + header_len + 9);
+
+    *meta = buf;
+    return 0;
+  }
+
+  // The normalization stage: slices are defined on the permuted data, so the mean and RMS
+  //    are gathered along the input axis that becomes the fastest output axis.
+  //
+  if (od[2] == 1) {  // Same as slice_norm(): 2D data is left unchanged.
+    uint8_t* buf = write_header(sizeof(uint32_t));
+    const uint32_t norm_len = sizeof(uint32_t);
+    std::memcpy(buf + header_len, &norm_len, sizeof(norm_len));
+    permute_tiles(input, dims, src_axis, output, [](auto v, size_t, size_t) { return T2(v); });
+    *meta = buf;
+    return 0;
+  }
+
+  const size_t dimx = od[0];
+  if (sizeof(uint32_t) + sizeof(double) * 2 * dimx > UINT32_MAX)
+    return 1;
+  const uint32_t norm_len = sizeof(uint32_t) + sizeof(double) * 2 * dimx;
+  const auto count = double(total_vals / dimx);
+
+  auto mean = sum_along(input, dims, src_axis[0], [](auto v, size_t) { return double(v); });
+  std::for_each(mean.begin(), mean.end(), [count](auto& v) { v /= count; });
+  auto rms = sum_along(input, dims, src_axis[0], [&mean](auto v, size_t c) {
+    const auto d = calc_type(v) - calc_type(mean[c]);
+    return double(d * d);
+  });
+  std::for_each(rms.begin(), rms.end(), [count](auto& v) { v = std::sqrt(v / count); });
+  std::replace(rms.begin(), rms.end(), 0.0, 1.0);
+
+  uint8_t* buf = write_header(norm_len);
+  std::memcpy(buf + header_len, &norm_len, sizeof(norm_len));
+  std::memcpy(buf + header_len + sizeof(uint32_t), mean.data(), sizeof(double) * dimx);
+  std::memcpy(buf + header_len + sizeof(uint32_t) + sizeof(double) * dimx, rms.data(),
+              sizeof(double) * dimx);
+
+  permute_tiles(input, dims, src_axis, output, [&](auto in, size_t, size_t o) {
+    const size_t x = o % dimx;
+    return T2((calc_type(in) - calc_type(mean[x])) / calc_type(rms[x]));
+  });
+
+  *meta = buf;
+  return 0;
+}
+template auto mkit::permute(const float*, float*, dims_type, uint8_t, uint8_t, void**) -> int;
+template auto mkit::permute(const float*, double*, dims_type, uint8_t, uint8_t, void**) -> int;
+template auto mkit::permute(const double*, float*, dims_type, uint8_t, uint8_t, void**) -> int;
+template auto mkit::permute(const double*, double*, dims_type, uint8_t, uint8_t, void**) -> int;
+
+template <typename T1, typename T2>
+auto mkit::inv_permute(const T1* input, T2* output, const void* meta) -> int
+{
+  const uint8_t* const p = static_cast<const uint8_t*>(meta);
+  const auto dims = retrieve_permute_dims(meta);
+  const uint8_t order = p[sizeof(uint64_t) * 4];
+  const uint8_t stage = p[sizeof(uint64_t) * 4 + 1];
+  if (order > PERMUTE_ZYX || stage > PERMUTE_STAGE_NORM)
+    return 1;
+  if (static_cast<const void*>(input) == static_cast<const void*>(output) &&
+      order != PERMUTE_XYZ)
+    return 1;
+
+  // Axis `a` of the original data is the axis of the permuted data that it was moved to.
+  using calc_type = std::common_type_t<T1, T2>;
+  const auto od = permuted_dims(dims, order);
+  size_t src_axis[3] = {0, 0, 0};
+  for (size_t a = 0; a < 3; a++)
+    src_axis[axes[order][a]] = a;
+  const uint8_t* const stage_meta = p + header_len;
+
+  if (stage == PERMUTE_STAGE_NONE ||
+      (stage == PERMUTE_STAGE_NORM && retrieve_slice_norm_meta_len(stage_meta) == 4)) {
+    permute_tiles(input, od, src_axis, output, [](auto v, size_t, size_t) { return T2(v); });
+    return 0;
+  }
+
+  if (stage == PERMUTE_STAGE_NORM) {
+    const size_t dimx = od[0];
+    auto mean = std::vector<double>(dimx), rms = std::vector<double>(dimx);
+    std::memcpy(mean.data(), stage_meta + sizeof(uint32_t), sizeof(double) * dimx);
+    std::memcpy(rms.data(), stage_meta + sizeof(uint32_t) + sizeof(double) * dimx,
+                sizeof(double) * dimx);
+    permute_tiles(input, od, src_axis, output, [&](auto in, size_t i, size_t) {
+      const size_t x = i % dimx;
+      return T2(calc_type(in) * calc_type(rms[x]) + calc_type(mean[x]));
+    });
+    return 0;
+  }
+
+  // The log stage: states are indexed in the order of the permuted data.
+  const size_t total_vals = dims[0] * dims[1] * dims[2];
+  auto [has_neg, has_zero, ternary, b3, b4, b5, b6, b7] = unpack_8_booleans(stage_meta[8]);
+  const uint8_t* const states = stage_meta + 9;
+  const size_t mask_num_bytes = (total_vals + 63) / 64 * 8;
+  const auto sign_mask = BitmaskView(states, has_neg ? total_vals : 0);
+  const auto zero_mask = BitmaskView(states + (has_neg ? mask_num_bytes : 0),
+                                     has_zero ? total_vals : 0);
+  constexpr uint8_t pow3[5] = {1, 3, 9, 27, 81};
+
+  permute_tiles(input, od, src_axis, output, [&](auto in, size_t i, size_t) {
+    uint8_t state = log_state_pos;
+    if (ternary)
+      state = states[i / 5] / pow3[i % 5] % 3;
+    else if (has_zero && zero_mask.read_bit(i))
+      state = log_state_zero;
+    else if (has_neg && !sign_mask.read_bit(i))
+      state = log_state_neg;
+
+    if (state == log_state_zero)
+      return T2{0};
+    const auto v = std::exp(calc_type(in));
+    return T2(state == log_state_neg ? -v : v);
+  });
+  return 0;
+}
+template auto mkit::inv_permute(const float*, float*, const void*) -> int;
+template auto mkit::inv_permute(const float*, double*, const void*) -> int;
+template auto mkit::inv_permute(const double*, float*, const void*) -> int;
+template auto mkit::inv_permute(const double*, double*, const void*) -> int;
+
+auto mkit::retrieve_permute_meta_len(const void* meta) -> size_t
+{
+  uint64_t len = 0;
+  std::memcpy(&len, meta, sizeof(len));
+  return len;
+}
+
+auto mkit::retrieve_permute_dims(const void* meta) -> dims_type
+{
+  uint64_t d[3] = {};
+  std::memcpy(d, static_cast<const uint8_t*>(meta) + sizeof(uint64_t), sizeof(d));
+  return {d[0], d[1], d[2]};
+}
@@ -0,0 +1,146 @@
+#include "MURaMKit.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// Preview definition:
+// total_len (uint64_t) + num_levels (uint64_t) +
+//   for each level: dims (3 x uint64_t) + byte offset of its values (uint64_t) +
+//   values of all levels (float)
+//
+constexpr size_t header_len = sizeof(uint64_t) * (2 + 4 * mkit::preview_levels);
+
+// Number of original values that fall in cell `i` of an axis with `len` values, when
+//    each cell covers `factor` values.
+inline auto cell_count(size_t i, size_t factor, size_t len) -> size_t
+{
+  return std::min(factor, len - i * factor);
+}
+
+};  // namespace
+
+auto mkit::preview_level_dims(dims_type dims, int level) -> dims_type
+{
+  const size_t f = size_t{1} << level;
+  return {(dims[0] + f - 1) / f, (dims[1] + f - 1) / f, (dims[2] + f - 1) / f};
+}
+
+auto mkit::calc_preview_len(dims_type dims) -> size_t
+{
+  size_t len = header_len;
+  for (int lev = 1; lev <= preview_levels; lev++) {
+    const auto d = preview_level_dims(dims, lev);
+    len += sizeof(float) * d[0] * d[1] * d[2];
+  }
+  return len;
+}
+
+auto mkit::finish_preview(dims_type dims, const double* sums) -> void*
+{
+  const uint64_t total_len = calc_preview_len(dims);
+  uint8_t* buf = static_cast<uint8_t*>(std::malloc(total_len));
+  const auto num_levels = uint64_t{preview_levels};
+  std::memcpy(buf, &total_len, sizeof(total_len));
+  std::memcpy(buf + 8, &num_levels, sizeof(num_levels));
+
+  // Sums of each level are derived from sums of the previous level, whose cells are
+  //    exactly 2x2x2 (or fewer at the upper boundaries) of the current level.
+  //
+  const auto d1 = preview_level_dims(dims, 1);
+  auto prev = std::vector<double>();
+  auto curr = std::vector<double>(sums, sums + d1[0] * d1[1] * d1[2]);
+  uint64_t offset = header_len;
+  for (int lev = 1; lev <= preview_levels; lev++) {
+    const auto d = preview_level_dims(dims, lev);
+    if (lev > 1) {
+      const auto pd = preview_level_dims(dims, lev - 1);
+      std::swap(prev, curr);
+      curr.assign(d[0] * d[1] * d[2], 0.0);
+#pragma omp parallel for
+      for (size_t z = 0; z < d[2]; z++)
+        for (size_t pz = z * 2; pz < std::min(pd[2], z * 2 + 2); pz++)
+          for (size_t py = 0; py < pd[1]; py++)
+            for (size_t px = 0; px < pd[0]; px++)
+              curr[(z * d[1] + py / 2) * d[0] + px / 2] += prev[(pz * pd[1] + py) * pd[0] + px];
+    }
+
+    // Record the dimensions and offset of this level, and turn sums into means.
+    //
+    uint8_t* entry = buf + sizeof(uint64_t) * (2 + 4 * (lev - 1));
+    for (size_t i = 0; i < 3; i++) {
+      const auto v = uint64_t{d[i]};
+      std::memcpy(entry + sizeof(uint64_t) * i, &v, sizeof(v));
+    }
+    std::memcpy(entry + sizeof(uint64_t) * 3, &offset, sizeof(offset));
+
+    const size_t f = size_t{1} << lev;
+    float* const vals = reinterpret_cast<float*>(buf + offset);
+#pragma omp parallel for
+    for (size_t z = 0; z < d[2]; z++)
+      for (size_t y = 0; y < d[1]; y++)
+        for (size_t x = 0; x < d[0]; x++) {
+          const auto count = cell_count(x, f, dims[0]) * cell_count(y, f, dims[1]) *
+                             cell_count(z, f, dims[2]);
+          const size_t idx = (z * d[1] + y) * d[0] + x;
+          vals[idx] = float(curr[idx] / double(count));
+        }
+    offset += sizeof(float) * d[0] * d[1] * d[2];
+  }
+
+  return buf;
+}
+
+template <typename T>
+auto mkit::preview_pyramid(const T* input, dims_type dims, void** preview) -> int
+{
+  if (*preview != nullptr || dims[0] * dims[1] * dims[2] == 0)
+    return 1;
+
+  // Every thread works on a pair of planes, which together make up one plane of level 1.
+  //
+  const auto d = preview_level_dims(dims, 1);
+  auto sums = std::vector<double>(d[0] * d[1] * d[2], 0.0);
+
+#pragma omp parallel for
+  for (size_t z2 = 0; z2 < d[2]; z2++)
+    for (size_t z = z2 * 2; z < std::min(dims[2], z2 * 2 + 2); z++)
+      for (size_t y = 0; y < dims[1]; y++) {
+        const T* row = input + (z * dims[1] + y) * dims[0];
+        double* cell = sums.data() + (z2 * d[1] + y / 2) * d[0];
+        for (size_t x = 0; x < dims[0]; x++)
+          cell[x / 2] += double(row[x]);
+      }
+
+  *preview = finish_preview(dims, sums.data());
+  return 0;
+}
+template auto mkit::preview_pyramid(const float*, dims_type, void**) -> int;
+template auto mkit::preview_pyramid(const double*, dims_type, void**) -> int;
+
+auto mkit::retrieve_preview_len(const void* preview) -> size_t
+{
+  uint64_t len = 0;
+  std::memcpy(&len, preview, sizeof(len));
+  return len;
+}
+
+auto mkit::retrieve_preview_level(const void* preview, int level, dims_type* dims)
+    -> const float*
+{
+  const uint8_t* const p = static_cast<const uint8_t*>(preview);
+  auto num_levels = uint64_t{0};
+  std::memcpy(&num_levels, p + 8, sizeof(num_levels));
+  if (level < 1 || uint64_t(level) > num_levels)
+    return nullptr;
+
+  const uint8_t* entry = p + sizeof(uint64_t) * (2 + 4 * (level - 1));
+  uint64_t vals[4] = {};
+  std::memcpy(vals, entry, sizeof(vals));
+  if (dims)
+    *dims = {vals[0], vals[1], vals[2]};
+  return reinterpret_cast<const float*>(p + vals[3]);
+}
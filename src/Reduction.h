@@ -0,0 +1,84 @@
+#ifndef REDUCTION_H
+#define REDUCTION_H
+
+/*
+ * Building blocks of the reductions over slices of a volume, shared by slice_norm() and
+ *   permute(). This header is internal to the library and not installed.
+ */
+
+#include "MURaMKit.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace mkit {
+
+// Per-thread partial sums of `len` values each. Rows start at cache line boundaries and are
+//    padded to whole cache lines, so that no two threads write to the same line. Rows are
+//    left uninitialized, to be zero-filled by clear() in parallel.
+class Partials {
+ public:
+  Partials(size_t num_rows, size_t len)
+      : m_len(len),
+        m_stride((len + line_vals - 1) / line_vals * line_vals),
+        m_num_rows(num_rows),
+        m_buf(std::make_unique_for_overwrite<double[]>(num_rows * m_stride + line_vals))
+  {
+    const auto addr = reinterpret_cast<uintptr_t>(m_buf.get());
+    m_first = m_buf.get() + (line_bytes - addr % line_bytes) % line_bytes / sizeof(double);
+  }
+
+  auto num_rows() const -> size_t { return m_num_rows; }
+  auto row(size_t r) -> double* { return m_first + r * m_stride; }
+  void clear(size_t r) { std::fill(row(r), row(r) + m_len, 0.0); }
+
+  // Write the sums of all rows to `dst`. Each thread sums a range of columns over all rows.
+  void merge(double* dst, int num_threads)
+  {
+#pragma omp parallel for num_threads(num_threads) if (m_len * m_num_rows >= 65536)
+    for (size_t i = 0; i < m_len; i++) {
+      auto sum = 0.0;
+      for (size_t r = 0; r < m_num_rows; r++)
+        sum += m_first[r * m_stride + i];
+      dst[i] = sum;
+    }
+  }
+
+ private:
+  static constexpr size_t line_bytes = 64;
+  static constexpr size_t line_vals = line_bytes / sizeof(double);
+
+  size_t m_len = 0;
+  size_t m_stride = 0;
+  size_t m_num_rows = 0;
+  std::unique_ptr<double[]> m_buf;
+  double* m_first = nullptr;
+};
+
+// Decomposition of a volume into tiles of `z_group` planes by `y_tile` rows, for reductions
+//    over its slices. Tiles are split along y as much as needed for every thread to get a
+//    few of them, even when dims[2] is small. `y_tile` is a multiple of `y_unit`, so that
+//    tiles can be aligned to preview cells or index blocks.
+struct Tiles {
+  size_t z_group = 1;
+  size_t y_tile = 1;
+  size_t num_z = 0;
+  size_t num_y = 0;
+
+  Tiles(dims_type dims, size_t group, size_t y_unit, int num_threads)
+      : z_group(group), num_z((dims[2] + group - 1) / group)
+  {
+    const size_t splits = std::max<size_t>(1, (size_t(num_threads) * 4 + num_z - 1) / num_z);
+    y_tile = (dims[1] + splits - 1) / splits;
+    y_tile = std::max<size_t>(1, (y_tile + y_unit - 1) / y_unit) * y_unit;
+    num_y = (dims[1] + y_tile - 1) / y_tile;
+  }
+
+  auto count() const -> size_t { return num_z * num_y; }
+};
+
+};  // namespace mkit
+
+#endif
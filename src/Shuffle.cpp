@@ -0,0 +1,290 @@
+#include "MURaMKit.h"
+#include <omp.h>
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+// Number of values processed by one task. Must be a multiplier of 8.
+constexpr size_t block_len = 8192;
+
+// Transpose an 8x8 bit matrix held in a 64-bit integer (Hacker's Delight, 7-3).
+// Applying it twice yields the original matrix.
+inline auto transpose_8x8(uint64_t x) -> uint64_t
+{
+  uint64_t t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAull;
+  x = x ^ t ^ (t << 7);
+  t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCull;
+  x = x ^ t ^ (t << 14);
+  t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ull;
+  x = x ^ t ^ (t << 28);
+  return x;
+}
+
+// Scatter bytes of values in [begin, end) into W byte planes, each of which has `stride` bytes.
+// When XOR is true, each value is XOR'ed with its predecessor first.
+template <size_t W, bool XOR>
+void scatter_bytes(const uint8_t* in, size_t begin, size_t end, uint8_t* planes, size_t stride)
+{
+  for (size_t b = 0; b < W; b++) {
+    uint8_t* dst = planes + b * stride;
+    size_t i = begin;
+    if (XOR && i == 0) {
+      dst[0] = in[b];
+      i = 1;
+    }
+#pragma omp simd
+    for (size_t j = i; j < end; j++) {
+      if constexpr (XOR)
+        dst[j - begin] = in[j * W + b] ^ in[(j - 1) * W + b];
+      else
+        dst[j - begin] = in[j * W + b];
+    }
+  }
+}
+
+// The reverse of scatter_bytes(), without undoing the XOR delta.
+template <size_t W>
+void gather_bytes(const uint8_t* planes, size_t stride, size_t begin, size_t end, uint8_t* out)
+{
+  for (size_t b = 0; b < W; b++) {
+    const uint8_t* src = planes + b * stride;
+#pragma omp simd
+    for (size_t j = begin; j < end; j++)
+      out[j * W + b] = src[j - begin];
+  }
+}
+
+// Undo the XOR delta, i.e., compute a prefix XOR of all values, in three parallel phases.
+template <size_t W>
+void undo_xor_delta(uint8_t* buf, size_t len)
+{
+  using word_t = std::conditional_t<W == 4, uint32_t, uint64_t>;
+  const size_t num_blocks = (len + block_len - 1) / block_len;
+  auto carry = std::vector<word_t>(num_blocks + 1, 0);
+
+  // Phase 1: prefix XOR within each block
+#pragma omp parallel for
+  for (size_t blk = 0; blk < num_blocks; blk++) {
+    const size_t end = std::min(len, (blk + 1) * block_len);
+    word_t acc = 0;
+    for (size_t i = blk * block_len; i < end; i++) {
+      word_t v;
+      std::memcpy(&v, buf + i * W, W);
+      acc ^= v;
+      std::memcpy(buf + i * W, &acc, W);
+    }
+    carry[blk + 1] = acc;
+  }
+
+  // Phase 2: prefix XOR of block totals
+  for (size_t blk = 1; blk <= num_blocks; blk++)
+    carry[blk] ^= carry[blk - 1];
+
+  // Phase 3: apply carries
+#pragma omp parallel for
+  for (size_t blk = 1; blk < num_blocks; blk++) {
+    const size_t end = std::min(len, (blk + 1) * block_len);
+    const word_t c = carry[blk];
+    for (size_t i = blk * block_len; i < end; i++) {
+      word_t v;
+      std::memcpy(&v, buf + i * W, W);
+      v ^= c;
+      std::memcpy(buf + i * W, &v, W);
+    }
+  }
+}
+
+template <size_t W, bool XOR>
+void shuffle(const uint8_t* in, size_t len, bool bit_plane, uint8_t* out)
+{
+  const size_t num_blocks = (len + block_len - 1) / block_len;
+
+  if (!bit_plane) {
+#pragma omp parallel for
+    for (size_t blk = 0; blk < num_blocks; blk++) {
+      const size_t begin = blk * block_len;
+      const size_t end = std::min(len, begin + block_len);
+      scatter_bytes<W, XOR>(in, begin, end, out + begin, len);
+    }
+    return;
+  }
+
+  // Bit plane mode: produce byte planes of a block, and then transpose groups of 8 bytes
+  //    so that bits of the same significance are grouped together.
+  const size_t plane_len = (len + 7) / 8;
+#pragma omp parallel
+  {
+    auto tmp = std::vector<uint8_t>(W * block_len);
+#pragma omp for
+    for (size_t blk = 0; blk < num_blocks; blk++) {
+      const size_t begin = blk * block_len;
+      const size_t end = std::min(len, begin + block_len);
+      std::fill(tmp.begin(), tmp.end(), 0);
+      scatter_bytes<W, XOR>(in, begin, end, tmp.data(), block_len);
+
+      const size_t num_groups = (end - begin + 7) / 8;
+      for (size_t b = 0; b < W; b++) {
+        uint8_t* dst = out + b * 8 * plane_len + begin / 8;
+        for (size_t g = 0; g < num_groups; g++) {
+          uint64_t x;
+          std::memcpy(&x, tmp.data() + b * block_len + g * 8, 8);
+          x = transpose_8x8(x);
+          for (size_t k = 0; k < 8; k++)
+            dst[k * plane_len + g] = uint8_t(x >> (k * 8));
+        }
+      }
+    }
+  }
+}
+
+template <size_t W>
+void unshuffle(const uint8_t* in, size_t len, bool bit_plane, bool xor_delta, uint8_t* out)
+{
+  const size_t num_blocks = (len + block_len - 1) / block_len;
+
+  if (!bit_plane) {
+#pragma omp parallel for
+    for (size_t blk = 0; blk < num_blocks; blk++) {
+      const size_t begin = blk * block_len;
+      const size_t end = std::min(len, begin + block_len);
+      gather_bytes<W>(in + begin, len, begin, end, out);
+    }
+  }
+  else {
+    const size_t plane_len = (len + 7) / 8;
+#pragma omp parallel
+    {
+      auto tmp = std::vector<uint8_t>(W * block_len);
+#pragma omp for
+      for (size_t blk = 0; blk < num_blocks; blk++) {
+        const size_t begin = blk * block_len;
+        const size_t end = std::min(len, begin + block_len);
+        const size_t num_groups = (end - begin + 7) / 8;
+        for (size_t b = 0; b < W; b++) {
+          const uint8_t* src = in + b * 8 * plane_len + begin / 8;
+          for (size_t g = 0; g < num_groups; g++) {
+            uint64_t x = 0;
+            for (size_t k = 0; k < 8; k++)
+              x |= uint64_t{src[k * plane_len + g]} << (k * 8);
+            x = transpose_8x8(x);
+            std::memcpy(tmp.data() + b * block_len + g * 8, &x, 8);
+          }
+        }
+        gather_bytes<W>(tmp.data(), block_len, begin, end, out);
+      }
+    }
+  }
+
+  if (xor_delta)
+    undo_xor_delta<W>(out, len);
+}
+
+};  // namespace
+
+//
+// Helper functions that work on raw bytes, so they do not require any alignment.
+//
+auto mkit::calc_shuffle_len(size_t num_vals, size_t width, uint8_t flags) -> size_t
+{
+  if (flags & SHUFFLE_BIT_PLANE)
+    return width * 8 * ((num_vals + 7) / 8);
+  else
+    return width * num_vals;
+}
+
+void mkit::shuffle_bytes(const void* input,
+                         size_t num_vals,
+                         size_t width,
+                         uint8_t flags,
+                         void* output)
+{
+  const auto* in = static_cast<const uint8_t*>(input);
+  auto* out = static_cast<uint8_t*>(output);
+  const bool bit_plane = flags & SHUFFLE_BIT_PLANE;
+  const bool xor_delta = flags & SHUFFLE_XOR_DELTA;
+
+  if (width == 4 && xor_delta)
+    shuffle<4, true>(in, num_vals, bit_plane, out);
+  else if (width == 4)
+    shuffle<4, false>(in, num_vals, bit_plane, out);
+  else if (xor_delta)
+    shuffle<8, true>(in, num_vals, bit_plane, out);
+  else
+    shuffle<8, false>(in, num_vals, bit_plane, out);
+}
+
+void mkit::unshuffle_bytes(const void* input,
+                           size_t num_vals,
+                           size_t width,
+                           uint8_t flags,
+                           void* output)
+{
+  const auto* in = static_cast<const uint8_t*>(input);
+  auto* out = static_cast<uint8_t*>(output);
+  const bool bit_plane = flags & SHUFFLE_BIT_PLANE;
+  const bool xor_delta = flags & SHUFFLE_XOR_DELTA;
+
+  if (width == 4)
+    unshuffle<4>(in, num_vals, bit_plane, xor_delta, out);
+  else
+    unshuffle<8>(in, num_vals, bit_plane, xor_delta, out);
+}
+
+//
+// byte_shuffle functions
+//
+template <typename T>
+auto mkit::byte_shuffle(const T* input, size_t len, uint8_t flags, void** output) -> int
+{
+  if (*output != nullptr)
+    return 1;
+
+  // Header definition:
+  // precision (1 byte) + flags (1 byte) + input_num_vals (8 byte)
+  //
+  const auto header_len = 10ul;
+  const auto total_len = header_len + calc_shuffle_len(len, sizeof(T), flags);
+  uint8_t* buf = static_cast<uint8_t*>(std::malloc(total_len));
+  buf[0] = std::is_same_v<T, float>;
+  buf[1] = flags;
+  std::memcpy(&buf[2], &len, sizeof(len));
+
+  shuffle_bytes(input, len, sizeof(T), flags, buf + header_len);
+  *output = buf;
+
+  return 0;
+}
+template auto mkit::byte_shuffle(const float*, size_t, uint8_t, void**) -> int;
+template auto mkit::byte_shuffle(const double*, size_t, uint8_t, void**) -> int;
+
+auto mkit::inv_byte_shuffle(const void* input, void** output) -> int
+{
+  if (*output != nullptr)
+    return 1;
+
+  const uint8_t* const p = static_cast<const uint8_t*>(input);
+  const auto header_len = 10ul;
+  const size_t width = p[0] ? sizeof(float) : sizeof(double);
+  const uint8_t flags = p[1];
+  size_t total_vals = 0;
+  std::memcpy(&total_vals, &p[2], sizeof(total_vals));
+
+  void* dst = std::malloc(total_vals * width);
+  unshuffle_bytes(p + header_len, total_vals, width, flags, dst);
+  *output = dst;
+
+  return 0;
+}
+
+auto mkit::retrieve_byte_shuffle_buf_len(const void* input) -> size_t
+{
+  const uint8_t* const p = static_cast<const uint8_t*>(input);
+  const size_t width = p[0] ? sizeof(float) : sizeof(double);
+  size_t total_vals = 0;
+  std::memcpy(&total_vals, &p[2], sizeof(total_vals));
+  return 10 + calc_shuffle_len(total_vals, width, p[1]);
+}
@@ -0,0 +1,128 @@
+#include "Sketch.h"
+#include <omp.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <utility>
+
+namespace {
+
+constexpr size_t half = mkit::Sketch::num_bins / 2;
+constexpr uint32_t key_shift = 19;       // Keep the sign, 8 exponent bits, and 4 mantissa bits.
+constexpr uint32_t key_mask = 0xFFF;     // 8 exponent bits + 4 mantissa bits
+constexpr uint32_t key_inf = 0xFF0;      // Key of infinity
+
+// The magnitude of the smallest and the largest single-precision values with a given key.
+auto key_range(uint32_t key) -> std::pair<double, double>
+{
+  if (key >= key_inf) {
+    const auto inf = std::numeric_limits<double>::infinity();
+    return {inf, inf};
+  }
+  const auto lo = std::bit_cast<float>(key << key_shift);
+  const auto hi = std::bit_cast<float>(((key + 1) << key_shift) - 1);
+  return {double(lo), double(hi)};
+}
+
+};  // namespace
+
+mkit::Sketch::Sketch() : m_counts(num_bins, 0) {}
+
+void mkit::Sketch::add(double val)
+{
+  if (val != val)
+    m_num_nan++;
+  else
+    m_counts[bin_of(val)]++;
+}
+
+template <typename T>
+void mkit::Sketch::add(const T* buf, size_t len)
+{
+  // Every thread accumulates into its own sketch, which are merged at the end.
+  //
+  auto locals = std::vector<Sketch>(omp_get_max_threads());
+
+#pragma omp parallel for
+  for (size_t i = 0; i < len; i++)
+    locals[omp_get_thread_num()].add(double(buf[i]));
+
+  for (const auto& l : locals)
+    merge(l);
+}
+template void mkit::Sketch::add(const float*, size_t);
+template void mkit::Sketch::add(const double*, size_t);
+
+void mkit::Sketch::merge(const Sketch& other)
+{
+  for (size_t i = 0; i < num_bins; i++)
+    m_counts[i] += other.m_counts[i];
+  m_num_nan += other.m_num_nan;
+}
+
+void mkit::Sketch::clear()
+{
+  std::fill(m_counts.begin(), m_counts.end(), 0);
+  m_num_nan = 0;
+}
+
+auto mkit::Sketch::count() const -> uint64_t
+{
+  return std::accumulate(m_counts.cbegin(), m_counts.cend(), uint64_t{0});
+}
+
+auto mkit::Sketch::num_nan() const -> uint64_t
+{
+  return m_num_nan;
+}
+
+auto mkit::Sketch::quantile(double q) const -> double
+{
+  const auto total = count();
+  if (total == 0)
+    return std::numeric_limits<double>::quiet_NaN();
+
+  // Find the bin that holds the value of rank `q * (total - 1)`.
+  const auto rank = uint64_t(std::clamp(q, 0.0, 1.0) * double(total - 1));
+  uint64_t seen = 0;
+  size_t bin = 0;
+  for (; bin < num_bins; bin++) {
+    seen += m_counts[bin];
+    if (seen > rank)
+      break;
+  }
+
+  const auto lo = bin_lower(bin), hi = bin_upper(bin);
+  return std::isinf(lo) ? lo : (lo + hi) / 2.0;
+}
+
+auto mkit::Sketch::histogram() const -> const std::vector<uint64_t>&
+{
+  return m_counts;
+}
+
+auto mkit::Sketch::bin_of(double val) -> size_t
+{
+  const auto bits = std::bit_cast<uint32_t>(float(val));
+  const uint32_t key = (bits >> key_shift) & key_mask;
+  return (bits >> 31) ? (half - 1 - key) : (half + key);
+}
+
+auto mkit::Sketch::bin_lower(size_t bin) -> double
+{
+  if (bin < half)
+    return -key_range(uint32_t(half - 1 - bin)).second;
+  else
+    return key_range(uint32_t(bin - half)).first;
+}
+
+auto mkit::Sketch::bin_upper(size_t bin) -> double
+{
+  if (bin < half)
+    return -key_range(uint32_t(half - 1 - bin)).first;
+  else
+    return key_range(uint32_t(bin - half)).second;
+}
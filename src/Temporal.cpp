@@ -0,0 +1,213 @@
+#include "MURaMKit.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+
+namespace {
+
+// A reference snapshot of one field. On the encoding side, a reference only becomes valid
+//    once the caller hands in the reconstruction of its keyframe.
+struct Reference {
+  std::mutex mutex;  // Serializes operations on the same field.
+  std::vector<uint8_t> vals;
+  bool is_float = false;
+  size_t len = 0;
+  uint32_t keyframe_id = 0;
+  uint32_t frames_since_key = 0;
+  bool valid = false;
+};
+
+// A library-managed cache of reference snapshots keyed by field names.
+class ReferenceCache {
+ public:
+  auto get(const std::string& field) -> std::shared_ptr<Reference>
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& ref = m_refs[field];
+    if (!ref)
+      ref = std::make_shared<Reference>();
+    return ref;
+  }
+
+  void clear(const char* field)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (field)
+      m_refs.erase(field);
+    else
+      m_refs.clear();
+  }
+
+ private:
+  std::mutex m_mutex;
+  std::unordered_map<std::string, std::shared_ptr<Reference>> m_refs;
+};
+
+// Encoders and decoders keep separate caches, so that a round trip in the same process
+// works as expected.
+auto encode_cache = ReferenceCache();
+auto decode_cache = ReferenceCache();
+
+// Meta data definition:
+// buf_len (uint64_t) + mode (uint8_t) + is_keyframe (uint8_t) + keyframe_id (uint32_t)
+//
+static_assert(mkit::temporal_meta_len == 14);
+
+template <typename T>
+void save_reference(Reference& ref, const T* buf, size_t buf_len)
+{
+  ref.vals.resize(buf_len * sizeof(T));
+  std::memcpy(ref.vals.data(), buf, buf_len * sizeof(T));
+  ref.is_float = std::is_same_v<T, float>;
+  ref.len = buf_len;
+  ref.valid = true;
+}
+
+};  // namespace
+
+template <typename T>
+auto mkit::temporal_delta(T* buf,
+                          size_t buf_len,
+                          const char* field,
+                          uint8_t mode,
+                          uint32_t keyframe_interval,
+                          void** meta) -> int
+{
+  if (*meta != nullptr || field == nullptr || mode > DELTA_RATIO)
+    return 1;
+
+  auto ref = encode_cache.get(field);
+  std::lock_guard<std::mutex> lock(ref->mutex);
+
+  const bool is_keyframe = !ref->valid || ref->len != buf_len ||
+                           ref->is_float != std::is_same_v<T, float> ||
+                           ref->frames_since_key + 1 >= keyframe_interval;
+
+  // A keyframe is only used as a reference once its reconstruction is known, so that the
+  //    encoder predicts from exactly the same values as the decoder.
+  if (is_keyframe) {
+    ref->vals.clear();
+    ref->is_float = std::is_same_v<T, float>;
+    ref->len = buf_len;
+    ref->valid = false;
+    ref->keyframe_id++;
+    ref->frames_since_key = 0;
+  }
+  else {
+    const T* r = reinterpret_cast<const T*>(ref->vals.data());
+    if (mode == DELTA_DIFF) {
+#pragma omp parallel for simd
+      for (size_t i = 0; i < buf_len; i++)
+        buf[i] -= r[i];
+    }
+    else {
+#pragma omp parallel for simd
+      for (size_t i = 0; i < buf_len; i++)
+        buf[i] = (r[i] != T{0}) ? buf[i] / r[i] : buf[i];
+    }
+    ref->frames_since_key++;
+  }
+
+  uint8_t* tmp_buf = static_cast<uint8_t*>(std::malloc(temporal_meta_len));
+  auto tmp64 = uint64_t{buf_len};
+  std::memcpy(tmp_buf, &tmp64, sizeof(tmp64));
+  tmp_buf[8] = mode;
+  tmp_buf[9] = is_keyframe;
+  std::memcpy(tmp_buf + 10, &ref->keyframe_id, sizeof(uint32_t));
+  *meta = tmp_buf;
+
+  return 0;
+}
+template auto mkit::temporal_delta(float*, size_t, const char*, uint8_t, uint32_t, void**) -> int;
+template auto mkit::temporal_delta(double*, size_t, const char*, uint8_t, uint32_t, void**)
+    -> int;
+
+template <typename T>
+auto mkit::set_temporal_reference(const T* buf, size_t buf_len, const char* field, const void* meta)
+    -> int
+{
+  const uint8_t* p = static_cast<const uint8_t*>(meta);
+  auto len = uint64_t{0};
+  std::memcpy(&len, p, sizeof(len));
+  const bool is_keyframe = p[9];
+  auto keyframe_id = uint32_t{0};
+  std::memcpy(&keyframe_id, p + 10, sizeof(keyframe_id));
+  if (len != buf_len || field == nullptr || !is_keyframe)
+    return 1;
+
+  auto ref = encode_cache.get(field);
+  std::lock_guard<std::mutex> lock(ref->mutex);
+
+  // Only the latest keyframe of a field can become its reference.
+  if (ref->keyframe_id != keyframe_id || ref->len != buf_len ||
+      ref->is_float != std::is_same_v<T, float>)
+    return 1;
+
+  save_reference(*ref, buf, buf_len);
+  return 0;
+}
+template auto mkit::set_temporal_reference(const float*, size_t, const char*, const void*)
+    -> int;
+template auto mkit::set_temporal_reference(const double*, size_t, const char*, const void*)
+    -> int;
+
+template <typename T>
+auto mkit::inv_temporal_delta(T* buf, size_t buf_len, const char* field, const void* meta)
+    -> int
+{
+  const uint8_t* p = static_cast<const uint8_t*>(meta);
+  auto len = uint64_t{0};
+  std::memcpy(&len, p, sizeof(len));
+  const uint8_t mode = p[8];
+  const bool is_keyframe = p[9];
+  auto keyframe_id = uint32_t{0};
+  std::memcpy(&keyframe_id, p + 10, sizeof(keyframe_id));
+  if (len != buf_len || field == nullptr || mode > DELTA_RATIO)
+    return 1;
+
+  auto ref = decode_cache.get(field);
+  std::lock_guard<std::mutex> lock(ref->mutex);
+
+  if (is_keyframe) {
+    save_reference(*ref, buf, buf_len);
+    ref->keyframe_id = keyframe_id;
+    return 0;
+  }
+
+  // The keyframe that this snapshot refers to needs to be decoded already.
+  if (!ref->valid || ref->keyframe_id != keyframe_id || ref->len != buf_len ||
+      ref->is_float != std::is_same_v<T, float>)
+    return 1;
+
+  const T* r = reinterpret_cast<const T*>(ref->vals.data());
+  if (mode == DELTA_DIFF) {
+#pragma omp parallel for simd
+    for (size_t i = 0; i < buf_len; i++)
+      buf[i] += r[i];
+  }
+  else {
+#pragma omp parallel for simd
+    for (size_t i = 0; i < buf_len; i++)
+      buf[i] = (r[i] != T{0}) ? buf[i] * r[i] : buf[i];
+  }
+
+  return 0;
+}
+template auto mkit::inv_temporal_delta(float*, size_t, const char*, const void*) -> int;
+template auto mkit::inv_temporal_delta(double*, size_t, const char*, const void*) -> int;
+
+auto mkit::retrieve_temporal_meta_len([[maybe_unused]] const void* meta) -> size_t
+{
+  return temporal_meta_len;
+}
+
+void mkit::clear_temporal_cache(const char* field)
+{
+  encode_cache.clear(field);
+  decode_cache.clear(field);
+}
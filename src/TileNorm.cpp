@@ -0,0 +1,193 @@
+#include "MURaMKit.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+
+namespace {
+
+// Meta data definition:
+// meta_len (uint64_t) + dims (3 x uint64_t) + tile dims (3 x uint32_t) +
+//   tile means (float) + tile rms (float)
+//
+constexpr size_t header_len = sizeof(uint64_t) * 4 + sizeof(uint32_t) * 3;
+
+auto num_tiles(mkit::dims_type dims, std::array<uint32_t, 3> tile) -> mkit::dims_type
+{
+  return {(dims[0] + tile[0] - 1) / tile[0], (dims[1] + tile[1] - 1) / tile[1],
+          (dims[2] + tile[2] - 1) / tile[2]};
+}
+
+// Visit all values of one tile, which is given by its begin and end coordinates.
+template <typename Func>
+void for_each_in_tile(mkit::dims_type dims,
+                      mkit::dims_type begin,
+                      mkit::dims_type end,
+                      Func&& func)
+{
+  for (size_t z = begin[2]; z < end[2]; z++)
+    for (size_t y = begin[1]; y < end[1]; y++) {
+      const size_t offset = (z * dims[1] + y) * dims[0];
+      for (size_t x = offset + begin[0]; x < offset + end[0]; x++)
+        func(x);
+    }
+}
+
+};  // namespace
+
+template <typename T>
+auto mkit::tile_norm(T* buf, dims_type dims, dims_type tile, void** meta) -> int
+{
+  return tile_norm(static_cast<const T*>(buf), buf, dims, tile, meta);
+}
+template auto mkit::tile_norm(float*, dims_type, dims_type, void**) -> int;
+template auto mkit::tile_norm(double*, dims_type, dims_type, void**) -> int;
+
+template <typename T1, typename T2>
+auto mkit::tile_norm(const T1* input, T2* output, dims_type dims, dims_type tile, void** meta)
+    -> int
+{
+  if (*meta != nullptr)
+    return 1;
+  for (size_t i = 0; i < 3; i++) {
+    if (dims[i] == 0 || tile[i] == 0 || tile[i] > UINT32_MAX)
+      return 1;
+  }
+
+  using calc_type = std::common_type_t<T1, T2>;
+  const auto tile32 = std::array<uint32_t, 3>{uint32_t(std::min(tile[0], dims[0])),
+                                              uint32_t(std::min(tile[1], dims[1])),
+                                              uint32_t(std::min(tile[2], dims[2]))};
+  const auto ntiles = num_tiles(dims, tile32);
+  const size_t total_tiles = ntiles[0] * ntiles[1] * ntiles[2];
+  const uint64_t meta_len = header_len + sizeof(float) * 2 * total_tiles;
+
+  uint8_t* tmp_buf = static_cast<uint8_t*>(std::malloc(meta_len));
+  std::memcpy(tmp_buf, &meta_len, sizeof(meta_len));
+  for (size_t i = 0; i < 3; i++) {
+    const auto d = uint64_t{dims[i]};
+    std::memcpy(tmp_buf + sizeof(uint64_t) * (i + 1), &d, sizeof(d));
+  }
+  std::memcpy(tmp_buf + sizeof(uint64_t) * 4, tile32.data(), sizeof(uint32_t) * 3);
+  float* const mean_buf = reinterpret_cast<float*>(tmp_buf + header_len);
+  float* const rms_buf = mean_buf + total_tiles;
+
+  // Each tile is small enough to stay in cache, so calculating its mean, its RMS, and then
+  //    normalizing its values only reads the tile from memory once.
+  //
+#pragma omp parallel for collapse(3) schedule(dynamic)
+  for (size_t tz = 0; tz < ntiles[2]; tz++)
+    for (size_t ty = 0; ty < ntiles[1]; ty++)
+      for (size_t tx = 0; tx < ntiles[0]; tx++) {
+        const auto begin = dims_type{tx * tile32[0], ty * tile32[1], tz * tile32[2]};
+        const auto end = dims_type{std::min(dims[0], begin[0] + tile32[0]),
+                                   std::min(dims[1], begin[1] + tile32[1]),
+                                   std::min(dims[2], begin[2] + tile32[2])};
+        const auto count =
+            double((end[0] - begin[0]) * (end[1] - begin[1]) * (end[2] - begin[2]));
+        const size_t idx = (tz * ntiles[1] + ty) * ntiles[0] + tx;
+
+        double sum = 0.0;
+        for_each_in_tile(dims, begin, end, [&](size_t i) { sum += double(input[i]); });
+        auto mean = float(sum / count);
+        if (!std::isfinite(mean))
+          mean = 0.f;
+
+        sum = 0.0;
+        for_each_in_tile(dims, begin, end, [&](size_t i) {
+          auto v = double(input[i]) - double(mean);
+          sum += v * v;
+        });
+        auto rms = float(std::sqrt(sum / count));
+        if (rms == 0.f || !std::isfinite(rms))
+          rms = 1.f;
+
+        for_each_in_tile(dims, begin, end, [&](size_t i) {
+          auto v = calc_type(input[i]) - calc_type(mean);
+          output[i] = T2(v / calc_type(rms));
+        });
+
+        mean_buf[idx] = mean;
+        rms_buf[idx] = rms;
+      }
+
+  *meta = tmp_buf;
+  return 0;
+}
+template auto mkit::tile_norm(const float*, float*, dims_type, dims_type, void**) -> int;
+template auto mkit::tile_norm(const float*, double*, dims_type, dims_type, void**) -> int;
+template auto mkit::tile_norm(const double*, float*, dims_type, dims_type, void**) -> int;
+template auto mkit::tile_norm(const double*, double*, dims_type, dims_type, void**) -> int;
+
+template <typename T>
+auto mkit::inv_tile_norm(T* buf, dims_type dims, const void* meta) -> int
+{
+  return inv_tile_norm(static_cast<const T*>(buf), buf, dims, meta);
+}
+template auto mkit::inv_tile_norm(float*, dims_type, const void*) -> int;
+template auto mkit::inv_tile_norm(double*, dims_type, const void*) -> int;
+
+template <typename T1, typename T2>
+auto mkit::inv_tile_norm(const T1* input, T2* output, dims_type dims, const void* meta) -> int
+{
+  using calc_type = std::common_type_t<T1, T2>;
+  const uint8_t* const p = static_cast<const uint8_t*>(meta);
+
+  // The recorded dimensions need to match the requested ones.
+  //
+  for (size_t i = 0; i < 3; i++) {
+    auto d = uint64_t{0};
+    std::memcpy(&d, p + sizeof(uint64_t) * (i + 1), sizeof(d));
+    if (d != dims[i])
+      return 1;
+  }
+  auto tile32 = std::array<uint32_t, 3>{};
+  std::memcpy(tile32.data(), p + sizeof(uint64_t) * 4, sizeof(uint32_t) * 3);
+  if (tile32[0] == 0 || tile32[1] == 0 || tile32[2] == 0)
+    return 1;
+
+  const auto ntiles = num_tiles(dims, tile32);
+  const size_t total_tiles = ntiles[0] * ntiles[1] * ntiles[2];
+  if (retrieve_tile_norm_meta_len(meta) != header_len + sizeof(float) * 2 * total_tiles)
+    return 1;
+
+  // The meta data might be kept at any offset of a bigger buffer (e.g., a container),
+  //    so the statistics are read in a way that does not require alignment.
+  //
+  const uint8_t* const mean_buf = p + header_len;
+  const uint8_t* const rms_buf = mean_buf + sizeof(float) * total_tiles;
+
+#pragma omp parallel for collapse(3) schedule(dynamic)
+  for (size_t tz = 0; tz < ntiles[2]; tz++)
+    for (size_t ty = 0; ty < ntiles[1]; ty++)
+      for (size_t tx = 0; tx < ntiles[0]; tx++) {
+        const auto begin = dims_type{tx * tile32[0], ty * tile32[1], tz * tile32[2]};
+        const auto end = dims_type{std::min(dims[0], begin[0] + tile32[0]),
+                                   std::min(dims[1], begin[1] + tile32[1]),
+                                   std::min(dims[2], begin[2] + tile32[2])};
+        const size_t idx = (tz * ntiles[1] + ty) * ntiles[0] + tx;
+        float mean = 0.f, rms = 0.f;
+        std::memcpy(&mean, mean_buf + sizeof(float) * idx, sizeof(float));
+        std::memcpy(&rms, rms_buf + sizeof(float) * idx, sizeof(float));
+        for_each_in_tile(dims, begin, end, [&](size_t i) {
+          output[i] = T2(calc_type(input[i]) * calc_type(rms) + calc_type(mean));
+        });
+      }
+
+  return 0;
+}
+template auto mkit::inv_tile_norm(const float*, float*, dims_type, const void*) -> int;
+template auto mkit::inv_tile_norm(const float*, double*, dims_type, const void*) -> int;
+template auto mkit::inv_tile_norm(const double*, float*, dims_type, const void*) -> int;
+template auto mkit::inv_tile_norm(const double*, double*, dims_type, const void*) -> int;
+
+auto mkit::retrieve_tile_norm_meta_len(const void* meta) -> size_t
+{
+  // Directly read the first 8 bytes
+  //
+  uint64_t len = 0;
+  std::memcpy(&len, meta, sizeof(len));
+  return len;
+}
@@ -0,0 +1,247 @@
+#include "Tune.h"
+#include "MURaMKit.h"
+#include <omp.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+// Profile definition (text, one entry per line):
+// "# MURaMKit tuning profile" +
+//   "procs <number of processors>" +
+//   for each tuned (operation, size class): "<operation name> <size class> <stride> <threads>"
+//
+const char* const op_names[mkit::tune_num_ops] = {"smart_log", "smart_exp", "slice_norm",
+                                                  "inv_slice_norm"};
+constexpr std::array<size_t, mkit::tune_num_classes> class_lens = {size_t{1} << 13,
+                                                                   size_t{1} << 16,
+                                                                   size_t{1} << 19,
+                                                                   size_t{1} << 22,
+                                                                   size_t{1} << 24};
+
+auto params_table = std::array<std::array<mkit::TuneParams, mkit::tune_num_classes>,
+                               mkit::tune_num_ops>{};
+auto load_flag = std::once_flag();
+
+auto valid(mkit::TuneParams p) -> bool
+{
+  return p.stride > 0 && p.stride % 64 == 0 && p.num_threads >= 0;
+}
+
+auto read_profile(const char* filename) -> int
+{
+  std::FILE* f = std::fopen(filename, "r");
+  if (!f)
+    return 1;
+
+  // Entries are only applied when the whole profile is good.
+  auto table = params_table;
+  auto line = std::array<char, 256>{};
+  auto rtn = 1;
+  while (std::fgets(line.data(), int(line.size()), f)) {
+    if (line[0] == '#' || line[0] == '\n')
+      continue;
+    int procs = 0;
+    if (std::sscanf(line.data(), "procs %d", &procs) == 1) {
+      if (procs != omp_get_num_procs())
+        break;
+      rtn = 0;
+      continue;
+    }
+    auto name = std::array<char, 64>{};
+    size_t cls = 0;
+    auto p = mkit::TuneParams();
+    if (std::sscanf(line.data(), "%63s %zu %zu %d", name.data(), &cls, &p.stride,
+                    &p.num_threads) != 4) {
+      rtn = 1;
+      break;
+    }
+    const auto op = std::find_if(std::begin(op_names), std::end(op_names),
+                                 [&](auto n) { return std::strcmp(n, name.data()) == 0; });
+    if (op == std::end(op_names) || cls >= mkit::tune_num_classes || !valid(p)) {
+      rtn = 1;
+      break;
+    }
+    table[op - std::begin(op_names)][cls] = p;
+  }
+  std::fclose(f);
+
+  if (rtn == 0)
+    params_table = table;
+  return rtn;
+}
+
+// Load the profile named by MKIT_TUNE_PROFILE, once, before parameters are used or changed.
+void ensure_loaded()
+{
+  std::call_once(load_flag, [] {
+    const char* filename = std::getenv("MKIT_TUNE_PROFILE");
+    if (filename && *filename)
+      read_profile(filename);
+  });
+}
+
+// The shortest time of `reps` runs of `f`, in seconds.
+template <typename F>
+auto time_best(F&& f, size_t reps) -> double
+{
+  auto best = std::numeric_limits<double>::infinity();
+  for (size_t r = 0; r < reps; r++) {
+    const auto start = omp_get_wtime();
+    f();
+    best = std::min(best, omp_get_wtime() - start);
+  }
+  return best;
+}
+
+};  // namespace
+
+auto mkit::tune_size_class(size_t len) -> size_t
+{
+  size_t cls = 0;
+  while (cls + 1 < tune_num_classes && len >= class_lens[cls] * 2)
+    cls++;
+  return cls;
+}
+
+auto mkit::tune_class_len(size_t size_class) -> size_t
+{
+  return class_lens[std::min(size_class, tune_num_classes - 1)];
+}
+
+auto mkit::tuned_params(uint8_t op, size_t len) -> TuneParams
+{
+  ensure_loaded();
+  auto p = TuneParams();
+  if (op < tune_num_ops)
+    p = params_table[op][tune_size_class(len)];
+  const int max_threads = omp_get_max_threads();
+  if (p.num_threads == 0 || p.num_threads > max_threads)
+    p.num_threads = max_threads;
+  return p;
+}
+
+auto mkit::set_tuned_params(uint8_t op, size_t size_class, TuneParams params) -> int
+{
+  if (op >= tune_num_ops || size_class >= tune_num_classes || !valid(params))
+    return 1;
+  ensure_loaded();
+  params_table[op][size_class] = params;
+  return 0;
+}
+
+auto mkit::tune(size_t max_len) -> int
+{
+  ensure_loaded();
+
+  auto thread_candidates = std::vector<int>();
+  const int max_threads = omp_get_max_threads();
+  for (int t = 1; t < max_threads; t *= 2)
+    thread_candidates.push_back(t);
+  thread_candidates.push_back(max_threads);
+  const auto stride_candidates = std::vector<size_t>{4096, 16384, 65536};
+  const auto default_stride = std::vector<size_t>{TuneParams().stride};
+
+  for (size_t cls = 0; cls < tune_num_classes; cls++) {
+    const auto len = class_lens[cls];
+    if (len > max_len)
+      continue;
+
+    // Synthetic data that spans many orders of magnitude and has negative values, so that
+    //    smart_log() takes its common path with a sign mask.
+    auto input = std::vector<float>(len);
+    auto output = std::vector<float>(len);
+    auto restored = std::vector<float>(len);
+#pragma omp parallel for
+    for (size_t i = 0; i < len; i++) {
+      const auto v = std::exp(std::sin(double(i) * 1e-3) * 8.0);
+      input[i] = float(i % 5 == 0 ? -v : v);
+    }
+    const auto dims = dims_type{32, 32, len / 1024};
+    const size_t reps = std::clamp<size_t>((size_t{1} << 22) / len, 3, 64);
+
+    for (uint8_t op = 0; op < tune_num_ops; op++) {
+      // Meta data that the inverse operations start from.
+      void* meta = nullptr;
+      auto rtn = 0;
+      if (op == TUNE_SMART_EXP)
+        rtn = smart_log(input.data(), output.data(), len, &meta);
+      else if (op == TUNE_INV_SLICE_NORM)
+        rtn = slice_norm(input.data(), output.data(), dims, &meta);
+      if (rtn) {
+        std::free(meta);
+        return rtn;
+      }
+
+      auto run = [&] {
+        void* tmp = nullptr;
+        switch (op) {
+          case TUNE_SMART_LOG:
+            rtn |= smart_log(input.data(), output.data(), len, &tmp);
+            break;
+          case TUNE_SMART_EXP:
+            rtn |= smart_exp(output.data(), restored.data(), len, meta);
+            break;
+          case TUNE_SLICE_NORM:
+            rtn |= slice_norm(input.data(), output.data(), dims, &tmp);
+            break;
+          default:
+            rtn |= inv_slice_norm(output.data(), restored.data(), dims, meta);
+        }
+        std::free(tmp);
+      };
+
+      auto best = TuneParams();
+      auto best_time = std::numeric_limits<double>::infinity();
+      const auto& strides = (op == TUNE_SMART_LOG) ? stride_candidates : default_stride;
+      for (auto stride : strides)
+        for (auto threads : thread_candidates) {
+          const auto p = TuneParams{stride, threads};
+          params_table[op][cls] = p;
+          const auto t = time_best(run, reps);
+          if (t < best_time) {
+            best_time = t;
+            best = p;
+          }
+        }
+      params_table[op][cls] = best;
+      std::free(meta);
+      if (rtn)
+        return rtn;
+    }
+  }
+
+  return 0;
+}
+
+auto mkit::save_tune_profile(const char* filename) -> int
+{
+  ensure_loaded();
+  std::FILE* f = std::fopen(filename, "w");
+  if (!f)
+    return 1;
+
+  std::fprintf(f, "# MURaMKit tuning profile\n");
+  std::fprintf(f, "procs %d\n", omp_get_num_procs());
+  for (size_t op = 0; op < tune_num_ops; op++)
+    for (size_t cls = 0; cls < tune_num_classes; cls++) {
+      const auto& p = params_table[op][cls];
+      std::fprintf(f, "%s %zu %zu %d\n", op_names[op], cls, p.stride, p.num_threads);
+    }
+
+  return std::fclose(f) == 0 ? 0 : 1;
+}
+
+auto mkit::load_tune_profile(const char* filename) -> int
+{
+  ensure_loaded();
+  return read_profile(filename);
+}
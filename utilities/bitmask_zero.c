@@ -61,22 +61,10 @@ int main(int argc, char* argv[])
   }
 
   /* Compare input and output */
-  FLT max = 0.0;
-  if (sizeof(FLT) == 4) {
-    const float* p1 = (const float*)inbuf;
-    const float* p2 = (const float*)output;
-    for (size_t i = 0; i < len; i++)
-      if (fabsf(p1[i] - p2[i]) > max)
-        max = fabsf(p1[i] - p2[i]);
-  }
-  else {
-    const double* p1 = (const double*)inbuf;
-    const double* p2 = (const double*)output;
-    for (size_t i = 0; i < len; i++)
-      if (fabs(p1[i] - p2[i]) > max)
-        max = fabs(p1[i] - p2[i]);
-  }
-  printf("-- analysis: compression max diff = %.2e\n", max);
+  struct mkit_metrics m;
+  mkit_compare(inbuf, output, sizeof(FLT) == 4, len, 0.0, &m);
+  printf("-- analysis: compression max diff = %.2e, values changed = %lu\n",
+             m.max_abs_err, m.num_over_threshold);
 
   /* Free previously allocated memory */
   free(inbuf);  
@@ -0,0 +1,341 @@
+//
+// Apply conditioning operations to many files listed in a manifest. The work is organized as
+// a three-stage pipeline: a reader thread loads the next file, the main thread conditions the
+// current file, and a writer thread stores the previous file. A fixed number of buffers are
+// recycled among the stages, so the memory footprint stays bounded regardless of the number
+// of files in the manifest.
+//
+// Each non-empty line of the manifest describes one job (lines starting with # are ignored):
+//
+//    operation  precision  input_file  output_file  [metadata_file]  [dim_fast dim_mid dim_slow]
+//
+//  - operation: smart_log, smart_exp, slice_norm, inv_slice_norm, bitmask_zero,
+//               or inv_bitmask_zero.
+//  - precision: float or double (ignored by inv_bitmask_zero).
+//  - metadata_file: written by smart_log and slice_norm, read by smart_exp and inv_slice_norm,
+//                   and not used by bitmask_zero and inv_bitmask_zero.
+//  - dims: only needed by slice_norm and inv_slice_norm.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MURaMKit.h"
+
+enum class Operation { smart_log, smart_exp, slice_norm, inv_slice_norm, bz, inv_bz };
+
+struct Job {
+  Operation op = Operation::smart_log;
+  bool is_float = false;
+  std::string infile;
+  std::string outfile;
+  std::string metafile;
+  mkit::dims_type dims = {0, 0, 0};
+};
+
+// A buffer slot that travels through the pipeline. Its vectors keep their capacity
+// when the slot is recycled, so that steady state processing does not allocate.
+struct Slot {
+  const Job* job = nullptr;
+  std::vector<uint8_t> data;
+  std::vector<uint8_t> meta_in;
+  void* meta_out = nullptr;  // Produced by the library; free() after writing.
+  void* aux_out = nullptr;   // Produced by the library; free() after writing.
+  size_t aux_len = 0;        // Number of bytes of `aux_out`.
+  int rtn = 0;               // Non-zero indicates an error at any stage.
+};
+
+// A minimal blocking queue that can be closed by the producer.
+template <typename T>
+class Channel {
+ public:
+  void push(T v)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_queue.push_back(std::move(v));
+    }
+    m_cv.notify_one();
+  }
+
+  auto pop() -> std::optional<T>
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [this] { return !m_queue.empty() || m_closed; });
+    if (m_queue.empty())
+      return std::nullopt;
+    auto v = std::move(m_queue.front());
+    m_queue.pop_front();
+    return v;
+  }
+
+  void close()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_closed = true;
+    }
+    m_cv.notify_all();
+  }
+
+ private:
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::deque<T> m_queue;
+  bool m_closed = false;
+};
+
+static auto parse_manifest(const std::string& filename, std::vector<Job>& jobs) -> int
+{
+  auto file = std::ifstream(filename);
+  if (!file.good()) {
+    std::cout << "!! cannot open manifest: " << filename << std::endl;
+    return 1;
+  }
+
+  auto line = std::string();
+  size_t line_num = 0;
+  while (std::getline(file, line)) {
+    line_num++;
+    auto iss = std::istringstream(line);
+    auto op = std::string(), precision = std::string();
+    if (!(iss >> op) || op[0] == '#')
+      continue;
+
+    auto job = Job();
+    iss >> precision >> job.infile >> job.outfile;
+    if (op == "smart_log")
+      job.op = Operation::smart_log;
+    else if (op == "smart_exp")
+      job.op = Operation::smart_exp;
+    else if (op == "slice_norm")
+      job.op = Operation::slice_norm;
+    else if (op == "inv_slice_norm")
+      job.op = Operation::inv_slice_norm;
+    else if (op == "bitmask_zero")
+      job.op = Operation::bz;
+    else if (op == "inv_bitmask_zero")
+      job.op = Operation::inv_bz;
+    else {
+      std::cout << "!! manifest line " << line_num << ": unknown operation " << op << std::endl;
+      return 1;
+    }
+    job.is_float = (precision == "float");
+    if (precision != "float" && precision != "double" && job.op != Operation::inv_bz) {
+      std::cout << "!! manifest line " << line_num << ": unknown precision " << precision
+                << std::endl;
+      return 1;
+    }
+    if (job.op != Operation::bz && job.op != Operation::inv_bz && !(iss >> job.metafile)) {
+      std::cout << "!! manifest line " << line_num << ": missing metadata file" << std::endl;
+      return 1;
+    }
+    if (job.op == Operation::slice_norm || job.op == Operation::inv_slice_norm) {
+      if (!(iss >> job.dims[0] >> job.dims[1] >> job.dims[2])) {
+        std::cout << "!! manifest line " << line_num << ": missing dimensions" << std::endl;
+        return 1;
+      }
+    }
+    if (job.infile.empty() || job.outfile.empty()) {
+      std::cout << "!! manifest line " << line_num << ": missing file names" << std::endl;
+      return 1;
+    }
+    jobs.push_back(std::move(job));
+  }
+
+  return 0;
+}
+
+static auto read_file(const std::string& filename, std::vector<uint8_t>& buf) -> int
+{
+  std::FILE* f = std::fopen(filename.c_str(), "rb");
+  if (!f)
+    return 1;
+  std::fseek(f, 0, SEEK_END);
+  const long len = std::ftell(f);
+  std::fseek(f, 0, SEEK_SET);
+  buf.resize(len);
+  auto nread = std::fread(buf.data(), 1, len, f);
+  std::fclose(f);
+  return (nread != size_t(len));
+}
+
+static auto write_file(const std::string& filename, const void* buf, size_t len) -> int
+{
+  std::FILE* f = std::fopen(filename.c_str(), "wb");
+  if (!f)
+    return 1;
+  auto nwrite = std::fwrite(buf, 1, len, f);
+  std::fclose(f);
+  return (nwrite != len);
+}
+
+template <typename T>
+static auto condition(Slot& slot) -> int
+{
+  const auto& job = *slot.job;
+  T* buf = reinterpret_cast<T*>(slot.data.data());
+  const size_t len = slot.data.size() / sizeof(T);
+  if (slot.data.size() % sizeof(T))
+    return 1;
+  if (job.op == Operation::slice_norm || job.op == Operation::inv_slice_norm) {
+    if (len != job.dims[0] * job.dims[1] * job.dims[2])
+      return 1;
+  }
+
+  switch (job.op) {
+    case Operation::smart_log:
+      return mkit::smart_log(buf, len, &slot.meta_out);
+    case Operation::smart_exp:
+      if (slot.meta_in.size() < 9 || mkit::retrieve_log_meta_len(slot.meta_in.data()) !=
+                                         slot.meta_in.size())
+        return 1;
+      return mkit::smart_exp(buf, len, slot.meta_in.data());
+    case Operation::slice_norm:
+      return mkit::slice_norm(buf, job.dims, &slot.meta_out);
+    case Operation::inv_slice_norm:
+      if (slot.meta_in.size() < 4 || mkit::retrieve_slice_norm_meta_len(slot.meta_in.data()) !=
+                                         slot.meta_in.size())
+        return 1;
+      return mkit::inv_slice_norm(buf, job.dims, slot.meta_in.data());
+    case Operation::bz: {
+      auto rtn = mkit::bitmask_zero(buf, len, &slot.aux_out);
+      if (rtn == 0)
+        slot.aux_len = mkit::retrieve_bitmask_zero_buf_len(slot.aux_out);
+      return rtn;
+    }
+    default:
+      return 1;
+  }
+}
+
+static auto condition(Slot& slot) -> int
+{
+  if (slot.job->op == Operation::inv_bz) {
+    if (slot.data.size() < 17 ||
+        mkit::retrieve_bitmask_zero_buf_len(slot.data.data()) != slot.data.size())
+      return 1;
+    auto rtn = mkit::inv_bitmask_zero(slot.data.data(), &slot.aux_out);
+    if (rtn == 0) {
+      uint64_t num_vals = 0;
+      std::memcpy(&num_vals, slot.data.data() + 1, sizeof(num_vals));
+      slot.aux_len = num_vals * ((slot.data[0] & 1) ? sizeof(float) : sizeof(double));
+    }
+    return rtn;
+  }
+  else if (slot.job->is_float)
+    return condition<float>(slot);
+  else
+    return condition<double>(slot);
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc != 2 && argc != 3) {
+    std::cout << "Usage: ./mkit_batch  manifest_file  [num_buffers (default 3)]" << std::endl;
+    return __LINE__;
+  }
+
+  auto jobs = std::vector<Job>();
+  if (parse_manifest(argv[1], jobs))
+    return __LINE__;
+  size_t num_buffers = 3;
+  if (argc == 3)
+    num_buffers = std::max(1l, std::atol(argv[2]));
+
+  auto slots = std::vector<Slot>(num_buffers);
+  auto free_slots = Channel<Slot*>();
+  auto loaded = Channel<Slot*>();
+  auto conditioned = Channel<Slot*>();
+  for (auto& s : slots)
+    free_slots.push(&s);
+
+  const auto start = std::chrono::steady_clock::now();
+  size_t bytes_read = 0, bytes_written = 0, num_failed = 0;
+
+  // Stage 1: read input files (and metadata of inverse operations).
+  auto reader = std::thread([&] {
+    for (const auto& job : jobs) {
+      auto* slot = *free_slots.pop();
+      slot->job = &job;
+      slot->rtn = read_file(job.infile, slot->data);
+      slot->meta_in.clear();
+      if (slot->rtn == 0 &&
+          (job.op == Operation::smart_exp || job.op == Operation::inv_slice_norm))
+        slot->rtn = read_file(job.metafile, slot->meta_in);
+      if (slot->rtn)
+        std::cout << "!! failed to read " << job.infile << std::endl;
+      else
+        bytes_read += slot->data.size() + slot->meta_in.size();
+      loaded.push(slot);
+    }
+    loaded.close();
+  });
+
+  // Stage 3: write output files (and metadata of forward operations).
+  auto writer = std::thread([&] {
+    while (auto next = conditioned.pop()) {
+      auto* slot = *next;
+      const auto& job = *slot->job;
+      if (slot->rtn == 0) {
+        if (slot->aux_out)
+          slot->rtn = write_file(job.outfile, slot->aux_out, slot->aux_len);
+        else
+          slot->rtn = write_file(job.outfile, slot->data.data(), slot->data.size());
+        bytes_written += slot->aux_out ? slot->aux_len : slot->data.size();
+      }
+      if (slot->rtn == 0 && slot->meta_out) {
+        auto meta_len = (job.op == Operation::smart_log)
+                            ? mkit::retrieve_log_meta_len(slot->meta_out)
+                            : mkit::retrieve_slice_norm_meta_len(slot->meta_out);
+        slot->rtn = write_file(job.metafile, slot->meta_out, meta_len);
+        bytes_written += meta_len;
+      }
+      if (slot->rtn) {
+        std::cout << "!! failed to process " << job.infile << std::endl;
+        num_failed++;
+      }
+
+      std::free(slot->meta_out);
+      std::free(slot->aux_out);
+      slot->meta_out = nullptr;
+      slot->aux_out = nullptr;
+      slot->aux_len = 0;
+      free_slots.push(slot);
+    }
+  });
+
+  // Stage 2: apply the conditioning operations on the main thread.
+  while (auto next = loaded.pop()) {
+    auto* slot = *next;
+    if (slot->rtn == 0)
+      slot->rtn = condition(*slot);
+    conditioned.push(slot);
+  }
+  conditioned.close();
+
+  reader.join();
+  writer.join();
+
+  const auto elapsed =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::printf("-- status: processed %lu jobs (%lu failed) in %.2f seconds\n", jobs.size(),
+              num_failed, elapsed);
+  std::printf("-- analysis: read %.2f MB, wrote %.2f MB, throughput = %.2f MB/s\n",
+              bytes_read / 1e6, bytes_written / 1e6, (bytes_read + bytes_written) / 1e6 / elapsed);
+
+  return (num_failed ? __LINE__ : 0);
+}
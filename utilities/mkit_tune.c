@@ -0,0 +1,42 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "MURaMKit_CAPI.h"
+
+int main(int argc, char** argv)
+{
+  if (argc != 2 && argc != 3) {
+    printf("Usage: ./mkit_tune  profile_file  [max_len]\n");
+    printf("       (benchmarks all size classes up to max_len values, 2^24 by default;\n");
+    printf("        point MKIT_TUNE_PROFILE to profile_file to use the results)\n");
+    return __LINE__;
+  }
+  const char* profile = argv[1];
+  const size_t max_len = (argc == 3) ? strtoull(argv[2], NULL, 10) : ((size_t)1 << 24);
+
+  printf("-- status: tuning size classes up to %lu values ...\n", max_len);
+  if (mkit_tune(max_len)) {
+    printf("!! error when tuning!\n");
+    return __LINE__;
+  }
+
+  const char* names[MKIT_TUNE_NUM_OPS] = {"smart_log", "smart_exp", "slice_norm",
+                                          "inv_slice_norm"};
+  printf("%16s %10s %8s %8s\n", "operation", "length", "stride", "threads");
+  for (int op = 0; op < MKIT_TUNE_NUM_OPS; op++)
+    for (size_t cls = 0; cls < MKIT_TUNE_NUM_CLASSES; cls++) {
+      const size_t len = mkit_tune_class_len(cls);
+      size_t stride = 0;
+      int num_threads = 0;
+      mkit_tuned_params(op, len, &stride, &num_threads);
+      printf("%16s %10lu %8lu %8d\n", names[op], len, stride, num_threads);
+    }
+
+  if (mkit_save_tune_profile(profile)) {
+    printf("!! error when writing profile: %s\n", profile);
+    return __LINE__;
+  }
+  printf("-- status: profile written to %s\n", profile);
+
+  return 0;
+}
@@ -22,7 +22,7 @@ int main(int argc, char* argv[])
   const size_t dimz = std::stoi(argv[4]);
   const auto total_len = dimx * dimy * dimz;
   auto psnr = 130.0;
-  if (argc = 7)
+  if (argc == 7)
     psnr = std::stod(argv[6]);
 
   // Read input file
@@ -93,9 +93,12 @@ int main(int argc, char* argv[])
   auto outbufd = decoder->release_decoded_data();
   decoder.reset();
 
+  // Post-conditioning writes directly to a single precision output buffer
+  auto outbuff = std::vector<float>(total_len);
+
 #ifdef SMART_LOG
   // Apply smart exp transform
-  rtni = mkit::smart_exp(outbufd.data(), total_len, meta);
+  rtni = mkit::smart_exp(outbufd.data(), outbuff.data(), total_len, meta);
   if (rtni) {
     std::cout << "post-conditioning failed!" << std::endl;
     std::free(meta);
@@ -105,17 +108,15 @@ int main(int argc, char* argv[])
 
 #ifdef SLICE_NORM
   // Apply inverse slice-based normalization
-  rtni = mkit::inv_slice_norm(outbufd.data(), {dimx, dimy, dimz}, meta);
+  rtni = mkit::inv_slice_norm(outbufd.data(), outbuff.data(), {dimx, dimy, dimz}, meta);
   if (rtni) {
     std::cout << "post-conditioning failed!" << std::endl;
     std::free(meta);
     return __LINE__;
   }
 #endif
-
-  // Make a copy of the data in single precision
-  auto outbuff = std::vector<float>(total_len);
-  std::copy(outbufd.begin(), outbufd.end(), outbuff.begin());
+  outbufd.clear();
+  outbufd.shrink_to_fit();
 
   // Write output file
   rtn = sperr::write_n_bytes(outfile, sizeof(float) * outbuff.size(), outbuff.data());
@@ -128,5 +129,12 @@ int main(int argc, char* argv[])
   if (meta)
     std::free(meta);
 
+  // Measure the achieved quality against the original values, which were conditioned in place.
+  inbuf = sperr::read_whole_file<float>(infile);
+  auto metrics = mkit::Metrics();
+  mkit::compare(inbuf.data(), outbuff.data(), total_len, 0.0, &metrics);
+  std::printf("Target PSNR = %.2f, achieved PSNR = %.2f, RMSE = %.2e, max error = %.2e\n", psnr,
+              metrics.psnr, metrics.rmse, metrics.max_abs_err);
+
   return 0;
 }
@@ -24,16 +24,17 @@ int main(int argc, char** argv)
     dim_mid  = atol(argv[3]);
     dim_slow = atol(argv[4]);
   }
-  else if (argc == 7) {
+  else if (argc == 6 || argc == 7) {
     infile   = argv[1];
     dim_fast = atol(argv[2]);
     dim_mid  = atol(argv[3]);
     dim_slow = atol(argv[4]);
     outfile  = argv[5];
-    outmeta  = argv[6];
+    outmeta  = (argc == 7) ? argv[6] : NULL;
   }
   else {
     printf("Usage: ./slice_norm input_file dim_fast dim_mid dim_slow [output_file]  [output_metadata]\n");
+    printf("       (when output_metadata is omitted, output_file is written as a .mkit container)\n");
     return __LINE__;
   }
 
@@ -62,38 +63,35 @@ int main(int argc, char** argv)
   assert(tmp == len);
   fclose(f);
 
-  /* apply slice norm to a copy */
+  /* apply slice norm to a copy; 2D fields are normalized in 64x64 tiles instead */
+  const int use_tiles = (dim_slow == 1);
   FLT* outbuf = (FLT*)malloc(len * sizeof(FLT));
   memcpy(outbuf, inbuf, len * sizeof(FLT));
   void* meta = NULL;
-  int rtn = mkit_slice_norm(outbuf, sizeof(FLT) == 4, dim_fast, dim_mid, dim_slow, &meta);
-  if (rtn) {
-    printf("!! error when applying slice normalization!\n");
-    return __LINE__;
+  void* preview = NULL; /* only built when writing a container */
+  int rtn = 0;
+  size_t meta_len = 0;
+  if (use_tiles) {
+    rtn = mkit_tile_norm(outbuf, sizeof(FLT) == 4, dim_fast, dim_mid, dim_slow, 64, 64, 1, &meta);
+    meta_len = rtn ? 0 : mkit_tile_norm_meta_len(meta);
+    if (rtn == 0 && outfile && !outmeta)
+      rtn = mkit_preview_pyramid(inbuf, sizeof(FLT) == 4, dim_fast, dim_mid, dim_slow, &preview);
+  }
+  else {
+    if (outfile && !outmeta)
+      rtn = mkit_slice_norm_preview(outbuf, sizeof(FLT) == 4, dim_fast, dim_mid, dim_slow, &meta,
+                                    &preview);
+    else
+      rtn = mkit_slice_norm(outbuf, sizeof(FLT) == 4, dim_fast, dim_mid, dim_slow, &meta);
+    meta_len = rtn ? 0 : mkit_slice_norm_meta_len(meta);
   }
-  else
-    printf("-- status: successfully applied slice normalization, meta size = %lu\n", 
-            mkit_slice_norm_meta_len(meta));
-
-  /* verification: apply inverse slice norm */
-  rtn = mkit_inv_slice_norm(outbuf, sizeof(FLT) == 4, dim_fast, dim_mid, dim_slow, meta);
   if (rtn) {
-    printf("!! error when applying inverse normalize!\n");
+    printf("!! error when applying %s normalization!\n", use_tiles ? "tile" : "slice");
     return __LINE__;
   }
   else
-    printf("-- status: successfully applied inverse slice normalization.\n");
-
-  /* print out the maximum difference */
-  double maxerr = 0.0, inval = 0.0, outval = 0.0;
-  for (size_t i = 0; i < len; i++)
-    if (fabs(inbuf[i] - outbuf[i]) > maxerr) {
-      inval = inbuf[i];
-      outval = outbuf[i];
-      maxerr = fabs(inbuf[i] - outbuf[i]);
-    }
-  printf("-- analysis: max error = %.2e, rel = %.2e, (orig = %.2e, xform = %.2e)\n",
-             maxerr, fabs(maxerr / inval), inval, outval);
+    printf("-- status: successfully applied %s normalization, meta size = %lu\n",
+            use_tiles ? "tile" : "slice", meta_len);
 
   /* write out transformed data if needed */
   if (outfile && outmeta) {
@@ -101,13 +99,56 @@ int main(int argc, char** argv)
     fwrite(outbuf, sizeof(FLT), len, f);
     fclose(f);
     f = fopen(outmeta, "w");
-    fwrite(meta, 1, mkit_log_meta_len(meta), f);
+    fwrite(meta, 1, meta_len, f);
     fclose(f);
   }
+  else if (outfile) { /* a .mkit container keeps the data, meta data, and a preview */
+    const char* name = strrchr(infile, '/') ? strrchr(infile, '/') + 1 : infile;
+    const uint8_t ops[1] = {use_tiles ? MKIT_OP_TILE_NORM : MKIT_OP_SLICE_NORM};
+    const uint8_t preview_ops[1] = {MKIT_OP_PREVIEW};
+    char preview_name[1024];
+    snprintf(preview_name, sizeof(preview_name), "%s.preview", name);
+    void* writer = mkit_container_create(outfile);
+    if (!writer || mkit_container_add_field(writer, name, sizeof(FLT) == 4, dim_fast, dim_mid,
+                                            dim_slow, ops, 1, outbuf, len * sizeof(FLT), meta,
+                                            meta_len) ||
+        mkit_container_add_field(writer, preview_name, 1, dim_fast, dim_mid, dim_slow,
+                                 preview_ops, 1, preview, mkit_preview_len(preview), NULL, 0)) {
+      printf("!! error when writing container %s\n", outfile);
+      return __LINE__;
+    }
+    if (mkit_container_finish(writer)) {
+      printf("!! error when writing container %s\n", outfile);
+      return __LINE__;
+    }
+  }
+
+  /* verification: apply inverse slice norm */
+  if (use_tiles)
+    rtn = mkit_inv_tile_norm(outbuf, sizeof(FLT) == 4, dim_fast, dim_mid, dim_slow, meta);
+  else
+    rtn = mkit_inv_slice_norm(outbuf, sizeof(FLT) == 4, dim_fast, dim_mid, dim_slow, meta);
+  if (rtn) {
+    printf("!! error when applying inverse normalize!\n");
+    return __LINE__;
+  }
+  else
+    printf("-- status: successfully applied inverse %s normalization.\n",
+            use_tiles ? "tile" : "slice");
+
+  /* print out the maximum difference */
+  struct mkit_metrics m;
+  mkit_compare(inbuf, outbuf, sizeof(FLT) == 4, len, 0.0, &m);
+  printf("-- analysis: max error = %.2e, rel = %.2e, (orig = %.2e, xform = %.2e)\n",
+             m.max_abs_err, m.max_rel_err, inbuf[m.max_abs_idx], outbuf[m.max_abs_idx]);
+  printf("-- analysis: RMSE = %.2e, PSNR = %.2f dB, bias = %.2e, inexact values = %lu\n",
+             m.rmse, m.psnr, m.bias, m.num_over_threshold);
 
   /* clean up allocated memory */
   if (meta)
     free(meta);
+  if (preview)
+    free(preview);
   free(outbuf);
   free(inbuf);
 }
@@ -16,13 +16,14 @@ int main(int argc, char** argv)
 
   if (argc == 2)
     infile = argv[1];
-  else if (argc == 4) {
+  else if (argc == 3 || argc == 4) {
     infile = argv[1];
     outfile = argv[2];
-    outmeta = argv[3];
+    outmeta = (argc == 4) ? argv[3] : NULL;
   }
   else {
     printf("Usage: ./smart_log  input_file  [output_file]  [output_metadata]\n");
+    printf("       (when output_metadata is omitted, output_file is written as a .mkit container)\n");
     return __LINE__;
   }
 
@@ -48,17 +49,12 @@ int main(int argc, char** argv)
   fclose(f);
 
   /* if there are negative values or absolute zeros */
-  int has_neg = 0, has_zero = 0;
-  for (size_t i = 0; i < len; i++)
-    if (inbuf[i] < 0.0) {
-      has_neg = 1;
-      break;
-    }
-  for (size_t i = 0; i < len; i++)
-    if (inbuf[i] == 0.0) {
-      has_zero = 1;
-      break;
-    }
+  struct mkit_analysis stats;
+  if (mkit_analyze(inbuf, sizeof(FLT) == 4, len, &stats)) {
+    printf("!! error when analyzing input!\n");
+    return __LINE__;
+  }
+  int has_neg = (stats.num_neg > 0), has_zero = (stats.num_zero > 0);
   printf("-- analysis: input has negative values: %d, has absolute zeros: %d\n", has_neg, has_zero);
 
   /* apply smart log to a copy */
@@ -73,22 +69,6 @@ int main(int argc, char** argv)
   else
     printf("-- status: successfully applying smart log, meta size = %lu\n", mkit_log_meta_len(meta));
 
-  /* verification: apply smart exp, and print out the maximum difference */
-  rtn = mkit_smart_exp(outbuf, sizeof(FLT) == 4, len, meta);
-  if (rtn) {
-    printf("!! error when applying smart expt!\n");
-    return __LINE__;
-  }
-  double maxerr = 0.0, inval = 0.0, outval = 0.0;
-  for (size_t i = 0; i < len; i++)
-    if (fabs(inbuf[i] - outbuf[i]) > maxerr) {
-      inval = inbuf[i];
-      outval = outbuf[i];
-      maxerr = fabs(inbuf[i] - outbuf[i]);
-    }
-  printf("-- analysis: max error = %.2e, rel = %.2e, (orig = %.2e, xform = %.2e)\n",
-             maxerr, fabs(maxerr / inval), inval, outval);
-
   /* write out transformed data if needed */
   if (outfile && outmeta) {
     f = fopen(outfile, "w");
@@ -98,6 +78,33 @@ int main(int argc, char** argv)
     fwrite(meta, 1, mkit_log_meta_len(meta), f);
     fclose(f);
   }
+  else if (outfile) { /* a .mkit container keeps both the data and meta data */
+    const char* name = strrchr(infile, '/') ? strrchr(infile, '/') + 1 : infile;
+    const uint8_t ops[1] = {MKIT_OP_SMART_LOG};
+    void* writer = mkit_container_create(outfile);
+    if (!writer || mkit_container_add_field(writer, name, sizeof(FLT) == 4, len, 1, 1, ops, 1, outbuf,
+                                            len * sizeof(FLT), meta, mkit_log_meta_len(meta))) {
+      printf("!! error when writing container %s\n", outfile);
+      return __LINE__;
+    }
+    if (mkit_container_finish(writer)) {
+      printf("!! error when writing container %s\n", outfile);
+      return __LINE__;
+    }
+  }
+
+  /* verification: apply smart exp, and print out the maximum difference */
+  rtn = mkit_smart_exp(outbuf, sizeof(FLT) == 4, len, meta);
+  if (rtn) {
+    printf("!! error when applying smart expt!\n");
+    return __LINE__;
+  }
+  struct mkit_metrics m;
+  mkit_compare(inbuf, outbuf, sizeof(FLT) == 4, len, 0.0, &m);
+  printf("-- analysis: max error = %.2e, rel = %.2e, (orig = %.2e, xform = %.2e)\n",
+             m.max_abs_err, m.max_rel_err, inbuf[m.max_abs_idx], outbuf[m.max_abs_idx]);
+  printf("-- analysis: RMSE = %.2e, PSNR = %.2f dB, bias = %.2e, inexact values = %lu\n",
+             m.rmse, m.psnr, m.bias, m.num_over_threshold);
 
   /* clean up allocated memory */
   if (meta)